@@ -0,0 +1,78 @@
+/*
+ ==============================================================================
+
+ Cost of the multi-band absorption stage against the first-order path, per
+ frame of 64 lines, exactly as FDN::process calls them.
+
+ Budget: the multi-band stage (8 octave bands, 7 biquads per line) may take
+ at most twice the time of the first-order path. Returns 1 when exceeded.
+
+ usage: tvfdn_absorption_benchmark [frames]
+
+ ==============================================================================
+ */
+
+#include "FDN.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+static constexpr double budget = 2.0;
+
+int main (int argc, char* argv[])
+{
+    const int numFrames = argc > 1 ? std::atoi (argv[1]) : 480000;
+    const size_t N = 64;
+
+    ImportedMatrices matrices;
+    dsp::Matrix<float> DELAYS { N, 1, matrices.delays.getRawDataPointer() };
+
+    dsp::ProcessSpec filterSpec { 48000.0, 256, 1 };
+
+    AbsorptionFilters firstOrder (DELAYS);
+    firstOrder.prepare (filterSpec);
+    firstOrder.updateFirstOrderFilter (3.f, 1.5f, 1000.f, 1.f);
+
+    MultiBandAbsorptionFilters multiBand (DELAYS);
+    multiBand.kernels = &Kernels::getBest();
+    multiBand.prepare (filterSpec);
+    multiBand.requestDesign (MultiBandAbsorptionFilters::defaultRT, 1.f);
+    multiBand.designPending();
+    multiBand.acquireCoefficients();
+
+    // precomputed input so that only the filters are timed
+    Random random (1);
+    std::vector<float> input (N * 4096);
+    for (auto& x : input)
+        x = random.nextFloat() - 0.5f;
+
+    dsp::Matrix<float> frame { 1, N };
+    dsp::Matrix<float> output { 1, N };
+    float sink = 0.f;
+
+    auto time = [&] (auto&& filterFrame)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < numFrames; ++i)
+        {
+            std::copy_n (input.data() + (size_t) (i % 4096) * N, N, frame.getRawDataPointer());
+            filterFrame();
+            sink += output (0, (size_t) i % N);
+        }
+
+        return std::chrono::duration<double, std::nano> (std::chrono::steady_clock::now() - start).count() / numFrames;
+    };
+
+    double firstOrderNs = time ([&] { output = firstOrder.filt (frame); });
+    double multiBandNs = time ([&] { output = frame; multiBand.filt (output.getRawDataPointer()); });
+    double ratio = multiBandNs / firstOrderNs;
+
+    std::printf ("first-order:  %8.1f ns per frame\n", firstOrderNs);
+    std::printf ("multi-band:   %8.1f ns per frame (%zu bands, %zu biquads per line, %s kernels)\n",
+                 multiBandNs, MultiBandAbsorptionFilters::numBands, MultiBandAbsorptionFilters::numStages, multiBand.kernels->name);
+    std::printf ("ratio:        %8.2f (budget %.1f)   [%g]\n", ratio, budget, (double) sink * 0.0);
+
+    return ratio <= budget ? 0 : 1;
+}
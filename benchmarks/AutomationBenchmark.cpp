@@ -0,0 +1,111 @@
+/*
+ ==============================================================================
+
+ Cost of sample-accurate automation through the C API: the time-varying
+ network with 0 to 64 points per block, alternating between the absorption
+ (RT_DC) and the oscillators (Osc_Frequency), for two block sizes. Each
+ point splits the block and redesigns the ramp, so the extra time per point
+ should not depend on the block size.
+
+ usage: tvfdn_automation_benchmark [seconds of audio]
+
+ ==============================================================================
+ */
+
+#include "tvfdn.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+static const int pointCounts[] { 0, 1, 4, 16, 64 };
+static constexpr int numCounts = 5;
+
+// one engine per block size; the point counts take turns block by block, so that they
+// share the kernel choice and any drift of the machine
+static std::vector<double> run (int blockSize, double seconds)
+{
+    const double sampleRate = 48000.0;
+    tvfdn_engine* engine = tvfdn_create();
+
+    if (engine == nullptr || tvfdn_prepare (engine, sampleRate, blockSize, TVFDN_NUM_CHANNELS, TVFDN_NUM_CHANNELS) != TVFDN_OK)
+    {
+        std::fprintf (stderr, "could not create the engine\n");
+        std::exit (1);
+    }
+
+    std::vector<std::vector<float>> channels (TVFDN_NUM_CHANNELS, std::vector<float> ((size_t) blockSize));
+    std::vector<float*> pointers;
+
+    for (auto& channel : channels)
+        pointers.push_back (channel.data());
+
+    std::mt19937 random (1);
+    std::uniform_real_distribution<float> noise (-0.1f, 0.1f);
+    std::uniform_real_distribution<float> unit (0.f, 1.f);
+
+    const auto numBlocks = (long) (seconds * sampleRate / blockSize) * numCounts;
+    std::vector<double> processing (numCounts, 0.0);
+
+    for (long b = 0; b < numBlocks; ++b)
+    {
+        const int points = pointCounts[b % numCounts];
+
+        for (auto& channel : channels)
+            for (auto& sample : channel)
+                sample = noise (random);
+
+        for (int p = 0; p < points; ++p)
+        {
+            const int offset = (p + 1) * blockSize / (points + 1);
+
+            if (p % 2 == 0)
+                tvfdn_schedule_param (engine, TVFDN_PARAM_RT_DC, 1.f + 5.f * unit (random), offset);
+            else
+                tvfdn_schedule_param (engine, TVFDN_PARAM_OSC_FREQUENCY, 0.5f + 4.f * unit (random), offset);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        tvfdn_process (engine, pointers.data(), pointers.data(), blockSize);
+        processing[(size_t) (b % numCounts)] += std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+    }
+
+    tvfdn_destroy (engine);
+
+    for (auto& time : processing)
+        time /= (double) (numBlocks / numCounts);
+
+    return processing;
+}
+
+int main (int argc, char* argv[])
+{
+    const double seconds = argc > 1 ? std::atof (argv[1]) : 5.0;
+
+    if (seconds <= 0.0)
+    {
+        std::fprintf (stderr, "usage: %s [seconds of audio]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf ("%-6s %-7s %12s %14s\n", "block", "points", "us / block", "us / point");
+
+    for (int blockSize : { 256, 1024 })
+    {
+        auto times = run (blockSize, seconds);
+
+        for (int c = 0; c < numCounts; ++c)
+        {
+            std::printf ("%-6d %-7d %12.1f", blockSize, pointCounts[c], 1e6 * times[(size_t) c]);
+
+            if (pointCounts[c] > 0)
+                std::printf (" %14.2f", 1e6 * (times[(size_t) c] - times[0]) / pointCounts[c]);
+
+            std::printf ("\n");
+        }
+    }
+
+    return 0;
+}
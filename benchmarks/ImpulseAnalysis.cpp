@@ -0,0 +1,709 @@
+/*
+ ==============================================================================
+
+ Impulse responses, energy decay curves and line decay rates of the static
+ network (TV Bypassed, first-order RT_DC/RT_NY absorption), computed from the
+ delays, the absorption filters and the feedback matrix of the engine,
+ without a host or audio files.
+
+ Nothing is rendered in time. The transfer matrix of the network,
+ H(z) = (I - A D(z))^-1 A D(z) with A the feedback matrix and
+ D(z) = diag(g_j(z) z^-m_j) the delayed, absorbed lines, is evaluated at the
+ bins of one real FFT, and the IRs are the inverse FFTs of its columns. The
+ bins are independent and spread over all cores, and each core solves a few
+ bins at once, one per SIMD lane (Gaussian elimination, in double for the
+ IRs and in float for the band decays). Only the columns needed are solved
+ for: the band decays come from the diffuse sum of the paths, weighted with
+ random signs a_o b_i (output times input), which is a^T H b and takes a
+ single right-hand side. A is dense and the
+ delays all differ, so each bin still needs one factorisation of an N x N
+ matrix; the work goes down with the number of bins instead.
+
+ The FFT size is the next power of two above the IR length (at least
+ 1.5 times the longer RT) plus 0.1 s, so the tail that folds back from past
+ the FFT length is 90 dB down. The band decays need less: a grid whose
+ period holds the slower decay down to -50 dB, every ratio-th bin of the
+ full one, and of each band only a slice: a Hann window in frequency
+ around its centre, an octave wide, but at most maxBandBins bins (375 Hz at
+ the default length), so from 500 Hz up the RT is the one at the band
+ centre. Its decay curve comes from the complex envelope of the window,
+ one short inverse FFT per band. Without a directory, only the bins of these
+ windows are solved (2943 of 65537 at the defaults).
+
+ For each octave band the tool prints the range of the per-line decay rates
+ |g_j(f)|^(1/m_j) across the lines and the band, as RT, next to the T30 of
+ the band's decay curve. These rates bound the pole radii of a network with
+ an orthogonal matrix only for frequency-independent gains; with the
+ first-order filters they are the decays the lines would have alone, and the
+ network decays in between when the absorption is matched to the delays.
+
+ With a directory, all bins are solved, and the IRs and EDCs of all paths
+ from the chosen inputs are written there as raw float32 files, described by
+ info.txt. The inputs are solved in groups whose spectra fit in 512 MiB, and
+ each path is written as soon as it is transformed, so memory does not grow
+ with the number of paths.
+
+ seconds defaults to 1.5 times the longer of RT_DC and RT_NY.
+
+ usage: tvfdn_ir_analysis [seconds] [RT_DC] [RT_NY] [crossover Hz] [delay factor] [input line|all] [directory]
+
+ ==============================================================================
+ */
+
+#include "FDN.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Complex = std::complex<double>;
+
+static constexpr size_t N = 64;
+static constexpr double sampleRate = 48000.0;
+static constexpr size_t numBands = MultiBandAbsorptionFilters::numBands;
+static constexpr size_t spectrumBudget = (size_t) 1 << 29;   // bytes of path spectra per group of inputs
+static constexpr size_t maxBandBins = 512;                   // widest band window, on the band grid
+
+struct Settings
+{
+    float RT_DC{1.5f};
+    float RT_NY{0.5f};
+    float crossover{1000.f};
+    float delayFactor{1.f};
+};
+
+// delays and absorption of each line as the engine designs them, and the feedback matrix
+// as the engine applies it: output[o] = sum_r A[o][r] input[r]
+struct Network
+{
+    std::vector<int> delays;
+    std::vector<double> b0, b1, a1;
+    std::vector<double> A;
+
+    Network (const Settings& settings)
+    {
+        ImportedMatrices matrices;
+        dsp::Matrix<float> DELAYS (N, 1, matrices.delays.getRawDataPointer());
+        dsp::ProcessSpec spec{sampleRate, 1, 1};
+
+        auto lines = std::make_unique<Delays> (DELAYS);
+        lines->updateDelayFactor (settings.delayFactor);
+
+        AbsorptionFilters absorption (DELAYS);
+        absorption.prepare (spec);
+        absorption.updateFirstOrderFilter (settings.RT_DC, settings.RT_NY, settings.crossover, settings.delayFactor);
+
+        delays = lines->lineDelay;
+        b0.assign (absorption.b0.begin(), absorption.b0.end());
+        b1.assign (absorption.b1.begin(), absorption.b1.end());
+        a1.assign (absorption.a1.begin(), absorption.a1.end());
+
+        // FDN::networkFrame multiplies with the transposed storage, row by row
+        const float* transposed = matrices.feedbackMatrixValuesTransposed.getRawDataPointer();
+        A.resize (N * N);
+        for (size_t o = 0; o < N; o++)
+            for (size_t r = 0; r < N; r++)
+                A[o * N + r] = transposed[r * N + o];
+    }
+
+    // g_j(z) z^-m_j at bin k of an fftSize-point DFT, the angle reduced exactly
+    Complex line (size_t j, size_t k, size_t fftSize) const
+    {
+        const double twoPi = MathConstants<double>::twoPi;
+        const Complex zInverse = std::polar (1.0, -twoPi * (double) k / (double) fftSize);
+        const Complex delay = std::polar (1.0, -twoPi * (double) ((k * (size_t) delays[j]) % fftSize) / (double) fftSize);
+        return delay * (b0[j] + b1[j] * zInverse) / (1.0 + a1[j] * zInverse);
+    }
+
+    // decay per sample of line j alone at frequency
+    double decayPerSample (size_t j, double frequency) const
+    {
+        const Complex zInverse = std::polar (1.0, -MathConstants<double>::twoPi * frequency / sampleRate);
+        const double gain = std::abs ((b0[j] + b1[j] * zInverse) / (1.0 + a1[j] * zInverse));
+        return std::pow (gain, 1.0 / delays[j]);
+    }
+};
+
+// Solves (I - A D) X = A D B for a few right-hand sides at up to `lanes` bins at once, one
+// bin per lane of every row operation, real and imaginary parts apart, so that the
+// elimination vectorises across the bins. There is no pivoting, the lanes would disagree
+// on it, and none is needed: A is orthogonal and all |d_j| < 1, so
+// Re x^H (I - A D) x >= (1 - max |d_j|) |x|^2 holds for every x, and with it for every
+// leading block, and no pivot comes near zero. Real is double for the IRs, float for the
+// decay analysis, lanes one AVX register of it. One per thread.
+template <typename Real>
+struct BinSolver
+{
+    static constexpr size_t lanes = 32 / sizeof (Real);
+
+    const Network& network;
+    size_t numColumns;
+    size_t width;
+    std::vector<Real> re, im;                 // [(row * width + column) * lanes + lane], N rows
+    std::vector<Real> dRe, dIm;               // [line * lanes + lane]
+    std::vector<Real> solutionRe, solutionIm; // [(row * numColumns + column) * lanes + lane]
+
+    BinSolver (const Network& _network, size_t _numColumns)
+        : network (_network), numColumns (_numColumns), width (N + _numColumns),
+          re (N * width * lanes), im (N * width * lanes), dRe (N * lanes), dIm (N * lanes),
+          solutionRe (N * _numColumns * lanes), solutionIm (N * _numColumns * lanes)
+    {
+    }
+
+    Complex solution (size_t row, size_t column, size_t lane) const
+    {
+        const size_t index = (row * numColumns + column) * lanes + lane;
+        return { (double) solutionRe[index], (double) solutionIm[index] };
+    }
+
+    // bins[0 .. numBins), at most lanes of them; column c of B is given by rhs (c, r), the
+    // weight of line r
+    template <typename RightHandSide>
+    void solve (const size_t* bins, size_t numBins, size_t fftSize, RightHandSide rhs)
+    {
+        // spare lanes repeat the last bin
+        for (size_t j = 0; j < N; j++)
+        {
+            for (size_t l = 0; l < lanes; l++)
+            {
+                const Complex d = network.line (j, bins[std::min (l, numBins - 1)], fftSize);
+                dRe[j * lanes + l] = (Real) d.real();
+                dIm[j * lanes + l] = (Real) d.imag();
+            }
+        }
+
+        for (size_t o = 0; o < N; o++)
+        {
+            for (size_t r = 0; r < N; r++)
+            {
+                const Real a = (Real) network.A[o * N + r];
+                const Real diagonal = o == r ? Real (1) : Real (0);
+                Real* entryRe = re.data() + (o * width + r) * lanes;
+                Real* entryIm = im.data() + (o * width + r) * lanes;
+
+                for (size_t l = 0; l < lanes; l++)
+                {
+                    entryRe[l] = diagonal - a * dRe[r * lanes + l];
+                    entryIm[l] = -a * dIm[r * lanes + l];
+                }
+            }
+
+            for (size_t c = 0; c < numColumns; c++)
+            {
+                Real* entryRe = re.data() + (o * width + N + c) * lanes;
+                Real* entryIm = im.data() + (o * width + N + c) * lanes;
+                std::fill (entryRe, entryRe + lanes, Real (0));
+                std::fill (entryIm, entryIm + lanes, Real (0));
+
+                for (size_t r = 0; r < N; r++)
+                {
+                    const Real weight = (Real) (network.A[o * N + r] * rhs (c, r));
+                    if (weight == Real (0))
+                        continue;
+
+                    for (size_t l = 0; l < lanes; l++)
+                    {
+                        entryRe[l] += weight * dRe[r * lanes + l];
+                        entryIm[l] += weight * dIm[r * lanes + l];
+                    }
+                }
+            }
+        }
+
+        for (size_t p = 0; p < N; p++)
+        {
+            Real inverseRe[lanes], inverseIm[lanes];
+            const Real* __restrict pivotRe = re.data() + p * width * lanes;
+            const Real* __restrict pivotIm = im.data() + p * width * lanes;
+
+            for (size_t l = 0; l < lanes; l++)
+            {
+                const Real pr = pivotRe[p * lanes + l], pi = pivotIm[p * lanes + l];
+                const Real magnitude = pr * pr + pi * pi;
+                inverseRe[l] = pr / magnitude;
+                inverseIm[l] = -pi / magnitude;
+            }
+
+            for (size_t i = p + 1; i < N; i++)
+            {
+                Real* __restrict rowRe = re.data() + i * width * lanes;
+                Real* __restrict rowIm = im.data() + i * width * lanes;
+                Real factorRe[lanes], factorIm[lanes];
+
+                for (size_t l = 0; l < lanes; l++)
+                {
+                    const Real xr = rowRe[p * lanes + l], xi = rowIm[p * lanes + l];
+                    factorRe[l] = xr * inverseRe[l] - xi * inverseIm[l];
+                    factorIm[l] = xr * inverseIm[l] + xi * inverseRe[l];
+                }
+
+                for (size_t j = p + 1; j < width; j++)
+                {
+                    for (size_t l = 0; l < lanes; l++)
+                    {
+                        const Real pr = pivotRe[j * lanes + l], pi = pivotIm[j * lanes + l];
+                        rowRe[j * lanes + l] -= factorRe[l] * pr - factorIm[l] * pi;
+                        rowIm[j * lanes + l] -= factorRe[l] * pi + factorIm[l] * pr;
+                    }
+                }
+            }
+        }
+
+        for (size_t c = 0; c < numColumns; c++)
+        {
+            for (size_t i = N; i-- > 0;)
+            {
+                const Real* rowRe = re.data() + i * width * lanes;
+                const Real* rowIm = im.data() + i * width * lanes;
+                Real sumRe[lanes], sumIm[lanes];
+
+                for (size_t l = 0; l < lanes; l++)
+                {
+                    sumRe[l] = rowRe[(N + c) * lanes + l];
+                    sumIm[l] = rowIm[(N + c) * lanes + l];
+                }
+
+                for (size_t j = i + 1; j < N; j++)
+                {
+                    const Real* xRe = solutionRe.data() + (j * numColumns + c) * lanes;
+                    const Real* xIm = solutionIm.data() + (j * numColumns + c) * lanes;
+
+                    for (size_t l = 0; l < lanes; l++)
+                    {
+                        const Real ur = rowRe[j * lanes + l], ui = rowIm[j * lanes + l];
+                        sumRe[l] -= ur * xRe[l] - ui * xIm[l];
+                        sumIm[l] -= ur * xIm[l] + ui * xRe[l];
+                    }
+                }
+
+                Real* xRe = solutionRe.data() + (i * numColumns + c) * lanes;
+                Real* xIm = solutionIm.data() + (i * numColumns + c) * lanes;
+
+                for (size_t l = 0; l < lanes; l++)
+                {
+                    const Real ur = rowRe[i * lanes + l], ui = rowIm[i * lanes + l];
+                    const Real magnitude = ur * ur + ui * ui;
+                    xRe[l] = (sumRe[l] * ur + sumIm[l] * ui) / magnitude;
+                    xIm[l] = (sumIm[l] * ur - sumRe[l] * ui) / magnitude;
+                }
+            }
+        }
+    }
+};
+
+// runs job (index) for index in [0, count) on all cores
+template <typename Job>
+static void parallelFor (size_t count, Job job)
+{
+    const size_t numThreads = std::max (1u, std::thread::hardware_concurrency());
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < numThreads; t++)
+    {
+        threads.emplace_back ([&]
+        {
+            for (size_t index = next++; index < count; index = next++)
+                job (index);
+        });
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// the first length samples of the real signal with spectrum bins 0 .. fftSize / 2
+template <typename Bin>
+static void inverseTransform (const dsp::FFT& fft, Bin bin, float* output, size_t length)
+{
+    const size_t fftSize = (size_t) fft.getSize();
+    std::vector<float> data (2 * fftSize, 0.f);
+
+    for (size_t k = 0; k <= fftSize / 2; k++)
+    {
+        const Complex value = bin (k);
+        data[2 * k] = (float) value.real();
+        data[2 * k + 1] = (float) value.imag();
+    }
+
+    fft.performRealOnlyInverseTransform (data.data());
+    std::copy_n (data.data(), length, output);
+}
+
+// Schroeder backward integration of an energy envelope, in dB re the total energy
+static std::vector<float> decayCurve (const std::vector<double>& energies)
+{
+    std::vector<float> curve (energies.size());
+    double energy = 0.0;
+
+    for (size_t n = energies.size(); n-- > 0;)
+    {
+        energy += energies[n];
+        curve[n] = (float) energy;
+    }
+
+    const double total = std::max (energy, 1e-300);
+    for (auto& value : curve)
+        value = (float) (10.0 * std::log10 (std::max ((double) value / total, 1e-30)));
+
+    return curve;
+}
+
+static std::vector<float> decayCurve (const float* response, size_t length)
+{
+    std::vector<double> energies (length);
+    for (size_t n = 0; n < length; n++)
+        energies[n] = (double) response[n] * response[n];
+
+    return decayCurve (energies);
+}
+
+// RT from a line fit of the decay curve, sampled every period seconds, between -5 and
+// -35 dB, or -5 and -25 dB (T20) when the curve does not reach -35 dB; 0 if it does not
+// reach -25 dB either
+static double reverberationTime (const std::vector<float>& curve, double period, bool& isT20)
+{
+    for (double end : { -35.0, -25.0 })
+    {
+        double n = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+        bool reached = false;
+
+        for (size_t i = 0; i < curve.size(); i++)
+        {
+            if (curve[i] > -5.f)
+                continue;
+
+            if (curve[i] < end)
+            {
+                reached = true;
+                break;
+            }
+
+            const double x = (double) i * period;
+            n += 1.0;
+            sx += x;
+            sy += curve[i];
+            sxx += x * x;
+            sxy += x * curve[i];
+        }
+
+        if (reached && n > 2.0)
+        {
+            isT20 = end > -35.0;
+            const double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+            return slope < 0.0 ? -60.0 / slope : 0.0;
+        }
+    }
+
+    return 0.0;
+}
+
+// the bins of band b: a Hann window around the centre, an octave wide or maxBandBins
+struct BandWindow
+{
+    size_t first = 0;
+    std::vector<double> weights;
+
+    BandWindow (size_t b, size_t fftSize)
+    {
+        const double binWidth = sampleRate / (double) fftSize;
+        const double centre = MultiBandAbsorptionFilters::bandFrequencies[b];
+        const double halfWidth = 0.5 * std::min (centre, (double) maxBandBins * binWidth);
+        first = (size_t) std::ceil ((centre - halfWidth) / binWidth);
+        const size_t last = (size_t) std::floor ((centre + halfWidth) / binWidth);
+
+        for (size_t k = first; k <= last; k++)
+        {
+            const double x = ((double) k * binWidth - centre) / halfWidth;
+            weights.push_back (std::pow (std::cos (0.5 * MathConstants<double>::pi * x), 2.0));
+        }
+    }
+};
+
+// T30 (or T20) of the diffuse response in band b, from the complex envelope of its window
+// sampled by an inverse FFT the size of the window: every fftSize / size samples
+template <typename Bin>
+static double bandReverberationTime (const BandWindow& window, size_t fftSize, size_t length, Bin bin, bool& isT20)
+{
+    int order = 1;
+    while (((size_t) 1 << order) < window.weights.size())
+        order++;
+
+    const dsp::FFT fft (order);
+    const size_t size = (size_t) 1 << order;
+    const size_t step = fftSize / size;
+    std::vector<std::complex<float>> spectrum (size), envelope (size);
+
+    for (size_t i = 0; i < window.weights.size(); i++)
+        spectrum[i] = std::complex<float> (window.weights[i] * bin (window.first + i));
+
+    fft.perform (spectrum.data(), envelope.data(), true);
+
+    std::vector<double> energies ((length + step - 1) / step);
+    for (size_t q = 0; q < energies.size(); q++)
+        energies[q] = std::norm (std::complex<double> (envelope[q]));
+
+    return reverberationTime (decayCurve (energies), (double) step / sampleRate, isT20);
+}
+
+int main (int argc, char* argv[])
+{
+    Settings settings;
+    double seconds = argc > 1 ? std::atof (argv[1]) : 0.0;
+    settings.RT_DC = argc > 2 ? (float) std::atof (argv[2]) : settings.RT_DC;
+    settings.RT_NY = argc > 3 ? (float) std::atof (argv[3]) : settings.RT_NY;
+    settings.crossover = argc > 4 ? (float) std::atof (argv[4]) : settings.crossover;
+    settings.delayFactor = argc > 5 ? (float) std::atof (argv[5]) : settings.delayFactor;
+    const std::string inputArgument = argc > 6 ? argv[6] : "0";
+    const std::string directory = argc > 7 ? argv[7] : "";
+
+    std::vector<int> inputs;
+    if (inputArgument == "all")
+    {
+        for (int i = 0; i < (int) N; i++)
+            inputs.push_back (i);
+    }
+    else
+    {
+        inputs.push_back (std::atoi (inputArgument.c_str()));
+    }
+
+    if (seconds <= 0.0)
+        seconds = 1.5 * std::max (settings.RT_DC, settings.RT_NY);
+
+    if (! (settings.RT_DC > 0.f) || ! (settings.RT_NY > 0.f) || ! (settings.delayFactor > 0.f) || settings.delayFactor > 5.f
+        || inputs[0] < 0 || inputs[0] >= (int) N)
+    {
+        std::fprintf (stderr, "usage: %s [seconds] [RT_DC] [RT_NY] [crossover Hz] [delay factor] [input line|all] [directory]\n", argv[0]);
+        return 1;
+    }
+
+    const Network network (settings);
+    const size_t length = (size_t) std::ceil (seconds * sampleRate);
+
+    // the IR folds back from past the FFT length: at least 1.5 RT, even for shorter IRs
+    const size_t span = std::max (length, (size_t) std::ceil (1.5 * std::max (settings.RT_DC, settings.RT_NY) * sampleRate));
+
+    int order = 1;
+    while (((size_t) 1 << order) < span + (size_t) (0.1 * sampleRate))
+        order++;
+
+    const dsp::FFT fft (order);
+    const size_t fftSize = (size_t) 1 << order;
+    const size_t numBins = fftSize / 2 + 1;
+
+    // the band decays on a grid of every ratio-th bin: its period still holds the slower
+    // decay down to -50 dB, which is all a T30 needs
+    int bandOrder = 1;
+    while (((size_t) 1 << bandOrder) < (size_t) std::ceil (5.0 / 6.0 * std::max (settings.RT_DC, settings.RT_NY) * sampleRate))
+        bandOrder++;
+
+    const size_t bandFFTSize = (size_t) 1 << std::min (bandOrder, order);
+    const size_t ratio = fftSize / bandFFTSize;
+    const size_t bandLength = std::min (length, bandFFTSize);
+
+    std::vector<BandWindow> windows;
+    for (size_t b = 0; b < numBands; b++)
+        windows.emplace_back (b, bandFFTSize);
+
+    // the signs of the diffuse sum, a_o b_i
+    std::vector<double> outputSigns (N), inputSigns (N);
+    std::mt19937 random (1);
+    for (auto* signs : { &outputSigns, &inputSigns })
+        for (auto& sign : *signs)
+            sign = (random() & 1) != 0 ? 1.0 : -1.0;
+
+    std::vector<Complex> diffuse (numBins);
+    size_t numSolvedBins = 0, numSolves = 0;
+    double solveTime = 0.0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (directory.empty())
+    {
+        // only the bins of the band windows, with one right-hand side: the inputs
+        // weighted with their signs
+        std::vector<bool> wanted (bandFFTSize / 2 + 1, false);
+        for (auto& window : windows)
+            std::fill_n (wanted.begin() + (long) window.first, window.weights.size(), true);
+
+        std::vector<size_t> bins;
+        for (size_t k = 0; k < wanted.size(); k++)
+            if (wanted[k])
+                bins.push_back (k * ratio);
+
+        std::vector<double> weights (N, 0.0);
+        for (int input : inputs)
+            weights[(size_t) input] = inputSigns[(size_t) input];
+
+        parallelFor ((bins.size() + 63) / 64, [&] (size_t chunk)
+        {
+            BinSolver<float> solver (network, 1);
+
+            for (size_t first = chunk * 64; first < std::min (bins.size(), (chunk + 1) * 64); first += solver.lanes)
+            {
+                const size_t count = std::min (solver.lanes, bins.size() - first);
+                solver.solve (bins.data() + first, count, fftSize, [&] (size_t, size_t r) { return weights[r]; });
+
+                for (size_t l = 0; l < count; l++)
+                {
+                    Complex sum;
+                    for (size_t o = 0; o < N; o++)
+                        sum += outputSigns[o] * solver.solution (o, 0, l);
+
+                    diffuse[bins[first + l]] = sum;
+                }
+            }
+        });
+
+        numSolvedBins = bins.size();
+        numSolves = 1;
+        solveTime = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+    }
+    else
+    {
+        FILE* responseFile = std::fopen ((directory + "/impulse_responses.raw").c_str(), "wb");
+        FILE* curveFile = std::fopen ((directory + "/decay_curves.raw").c_str(), "wb");
+        FILE* info = std::fopen ((directory + "/info.txt").c_str(), "w");
+        bool written = responseFile != nullptr && curveFile != nullptr && info != nullptr;
+
+        // the spectra of all paths from a group of inputs, then the paths one input at a time
+        const size_t groupSize = std::clamp (spectrumBudget / (N * numBins * sizeof (std::complex<float>)), (size_t) 1, inputs.size());
+        std::vector<std::complex<float>> spectra (groupSize * N * numBins);   // [(column * N + output) * numBins + bin]
+        std::vector<float> responses (N * length), curves (N * length);
+
+        for (size_t first = 0; written && first < inputs.size(); first += groupSize)
+        {
+            const size_t numColumns = std::min (groupSize, inputs.size() - first);
+            auto solveStart = std::chrono::steady_clock::now();
+
+            parallelFor ((numBins + 63) / 64, [&] (size_t chunk)
+            {
+                BinSolver<double> solver (network, numColumns);
+                size_t bins[BinSolver<double>::lanes];
+
+                for (size_t k0 = chunk * 64; k0 < std::min (numBins, (chunk + 1) * 64); k0 += solver.lanes)
+                {
+                    const size_t count = std::min (solver.lanes, numBins - k0);
+                    for (size_t l = 0; l < count; l++)
+                        bins[l] = k0 + l;
+
+                    solver.solve (bins, count, fftSize, [&] (size_t c, size_t r) { return r == (size_t) inputs[first + c] ? 1.0 : 0.0; });
+
+                    for (size_t l = 0; l < count; l++)
+                    {
+                        for (size_t c = 0; c < numColumns; c++)
+                        {
+                            Complex sum;
+                            for (size_t o = 0; o < N; o++)
+                            {
+                                const Complex value = solver.solution (o, c, l);
+                                spectra[(c * N + o) * numBins + k0 + l] = std::complex<float> ((float) value.real(), (float) value.imag());
+                                sum += outputSigns[o] * value;
+                            }
+
+                            diffuse[k0 + l] += inputSigns[(size_t) inputs[first + c]] * sum;
+                        }
+                    }
+                }
+            });
+
+            numSolves++;
+            solveTime += std::chrono::duration<double> (std::chrono::steady_clock::now() - solveStart).count();
+
+            for (size_t c = 0; written && c < numColumns; c++)
+            {
+                parallelFor (N, [&] (size_t o)
+                {
+                    const std::complex<float>* spectrum = spectra.data() + (c * N + o) * numBins;
+                    float* response = responses.data() + o * length;
+                    inverseTransform (fft, [&] (size_t k) { return Complex (spectrum[k]); }, response, length);
+
+                    auto curve = decayCurve (response, length);
+                    std::copy (curve.begin(), curve.end(), curves.begin() + (long) (o * length));
+                });
+
+                written = std::fwrite (responses.data(), sizeof (float), responses.size(), responseFile) == responses.size()
+                       && std::fwrite (curves.data(), sizeof (float), curves.size(), curveFile) == curves.size();
+            }
+        }
+
+        if (written)
+        {
+            std::fprintf (info, "sample rate: %.0f\nsamples per path: %zu\nRT_DC: %g\nRT_NY: %g\ncrossover: %g\ndelay factor: %g\n",
+                          sampleRate, length, settings.RT_DC, settings.RT_NY, settings.crossover, settings.delayFactor);
+            std::fprintf (info, "impulse_responses.raw: float32, path after path, path = input after input, output line 0 to %zu within an input\n", N - 1);
+            std::fprintf (info, "decay_curves.raw: float32 in dB re the total energy of the path, same layout\ninputs:");
+            for (int input : inputs)
+                std::fprintf (info, " %d", input);
+            std::fprintf (info, "\n");
+        }
+
+        for (FILE* file : { responseFile, curveFile, info })
+            written = file != nullptr && std::fclose (file) == 0 && written;
+
+        if (! written)
+        {
+            std::fprintf (stderr, "could not write to %s\n", directory.c_str());
+            return 1;
+        }
+
+        numSolvedBins = numBins;
+    }
+
+    // the bands of the diffuse response, and the range of the line decays across each band
+    std::vector<double> bandRT (numBands);
+    std::vector<bool> bandT20 (numBands);
+    std::vector<double> minDecay (numBands, 1.0), maxDecay (numBands, 0.0);
+
+    parallelFor (numBands, [&] (size_t b)
+    {
+        bool isT20 = false;
+        bandRT[b] = bandReverberationTime (windows[b], bandFFTSize, bandLength, [&] (size_t k) { return diffuse[k * ratio]; }, isT20);
+        bandT20[b] = isT20;
+
+        // the filters are smooth, 32 frequencies across the octave find the extremes
+        const double centre = MultiBandAbsorptionFilters::bandFrequencies[b];
+        for (int f = 0; f <= 32; f++)
+        {
+            const double frequency = centre * std::pow (2.0, (f - 16) / 32.0);
+            for (size_t j = 0; j < N; j++)
+            {
+                minDecay[b] = std::min (minDecay[b], network.decayPerSample (j, frequency));
+                maxDecay[b] = std::max (maxDecay[b], network.decayPerSample (j, frequency));
+            }
+        }
+    });
+
+    const double elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+
+    std::printf ("%zu paths of %.2f s, %zu of %zu bins x %zu solve%s on %u threads: %.3f s, of which %.3f s for the solves\n\n",
+                 inputs.size() * N, seconds, numSolvedBins, numBins, numSolves, numSolves == 1 ? "" : "s",
+                 std::max (1u, std::thread::hardware_concurrency()), elapsed, solveTime);
+    std::printf ("%-8s %-23s %-15s %s\n", "band", "line decay / sample", "RT lines (s)", "RT decay (s)");
+
+    // a decay r per sample is 20 log10 r dB
+    auto decayToRT = [] (double decay) { return decay < 1.0 ? -3.0 / (sampleRate * std::log10 (decay)) : INFINITY; };
+
+    for (size_t b = 0; b < numBands; b++)
+    {
+        std::printf ("%-8.0f %.6f - %.6f    %5.2f - %5.2f   ", MultiBandAbsorptionFilters::bandFrequencies[b], minDecay[b], maxDecay[b],
+                     decayToRT (minDecay[b]), decayToRT (maxDecay[b]));
+
+        if (bandRT[b] > 0.0)
+            std::printf ("%5.2f%s\n", bandRT[b], bandT20[b] ? " (T20)" : "");
+        else
+            std::printf ("  -   (decays less than 25 dB, analyse longer)\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ ==============================================================================
+
+ Accuracy and cost of the 16-bit delay storage (fp16, bfloat16) against
+ float, through FDN::process with the longest delays (Delay_Factor 5), with
+ and without the time-varying matrix.
+
+ The SNR is the energy of the float output over the energy of the
+ difference, over a noise burst and its tail. Every engine runs the same
+ kernel variant and block size, so the storage format is the only
+ difference.
+
+ Budget: fp16 has to stay above minHalfSNR dB. Returns 1 otherwise.
+ bfloat16 and the timings are only reported.
+
+ usage: tvfdn_precision_benchmark [seconds of audio]
+
+ ==============================================================================
+ */
+
+#include "FDN.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <vector>
+
+static constexpr double minHalfSNR = 50.0;
+
+int main (int argc, char* argv[])
+{
+    const double sampleRate = 48000.0;
+    const int blockSize = 256;
+    const double seconds = argc > 1 ? std::atof (argv[1]) : 10.0;
+    const int numBlocks = (int) (seconds * sampleRate / blockSize);
+    const int burstBlocks = (int) (0.1 * sampleRate / blockSize);
+
+    const Delays::Precision precisions[] { Delays::Precision::float32, Delays::Precision::float16, Delays::Precision::bfloat16 };
+    const char* const names[] { "float32", "float16", "bfloat16" };
+
+    std::vector<std::unique_ptr<FDN>> fdns;
+
+    for (size_t p = 0; p < 3; ++p)
+        fdns.push_back (std::make_unique<FDN>());
+
+    const int numChannels = (int) fdns[0]->N;
+    dsp::ProcessSpec spec { sampleRate, (uint32) blockSize, (uint32) numChannels };
+    dsp::ProcessSpec filterSpec = spec;
+    filterSpec.numChannels = 1;
+
+    for (size_t p = 0; p < 3; ++p)
+    {
+        auto& fdn = fdns[p];
+        fdn->autotune = false;
+        fdn->setDelayPrecision (precisions[p]);
+        fdn->prepare (spec, filterSpec);
+
+        // the largest working set: about 1.9 MB of float lines
+        fdn->delayFactor = 5.f;
+        fdn->RT_DC = 6.f;
+        fdn->RT_NY = 2.f;
+    }
+
+    AudioBuffer<float> input (numChannels, blockSize);
+    AudioBuffer<float> silence (numChannels, blockSize);
+    silence.clear();
+    std::mt19937 random (1);
+    std::uniform_real_distribution<float> noise (-0.1f, 0.1f);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        for (int i = 0; i < blockSize; ++i)
+            input.setSample (ch, i, noise (random));
+
+    bool ok = true;
+    std::printf ("%-8s %-9s %10s %10s\n", "matrix", "storage", "SNR dB", "CPU %");
+
+    for (bool tvBypassed : { true, false })
+    {
+        std::vector<AudioBuffer<float>> buffers (3, AudioBuffer<float> (numChannels, blockSize));
+        std::vector<double> time (3, 0.0);
+        double signal = 0.0;
+        std::vector<double> error (3, 0.0);
+
+        for (auto& fdn : fdns)
+        {
+            fdn->TVBypassed = tvBypassed;
+            fdn->prepare (spec, filterSpec);   // clears the tails
+        }
+
+        ScopedNoDenormals noDenormals;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            for (size_t p = 0; p < fdns.size(); ++p)
+            {
+                buffers[p].makeCopyOf (b < burstBlocks ? input : silence, true);
+                dsp::AudioBlock<float> block (buffers[p]);
+
+                auto start = std::chrono::steady_clock::now();
+                fdns[p]->process (block);
+                time[p] += std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+            }
+
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                auto* reference = buffers[0].getReadPointer (ch);
+
+                for (int i = 0; i < blockSize; ++i)
+                {
+                    signal += (double) reference[i] * reference[i];
+
+                    for (size_t p = 1; p < fdns.size(); ++p)
+                    {
+                        double e = (double) buffers[p].getSample (ch, i) - reference[i];
+                        error[p] += e * e;
+                    }
+                }
+            }
+        }
+
+        for (size_t p = 0; p < fdns.size(); ++p)
+        {
+            double snr = p == 0 ? INFINITY : 10.0 * std::log10 (signal / jmax (error[p], 1e-30));
+            ok = ok && (precisions[p] != Delays::Precision::float16 || snr >= minHalfSNR);
+
+            std::printf ("%-8s %-9s %10.1f %10.2f\n", tvBypassed ? "static" : "TV", names[p], snr, 100.0 * time[p] / seconds);
+        }
+    }
+
+    std::printf ("(%s kernels)\n", fdns[0]->kernels->name);
+
+    return ok ? 0 : 1;
+}
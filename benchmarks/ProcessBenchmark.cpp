@@ -0,0 +1,76 @@
+/*
+ ==============================================================================
+
+ Throughput of the engine through its C API.
+
+ usage: tvfdn_process_benchmark [blockSize] [seconds] [tv|static]
+
+ ==============================================================================
+ */
+
+#include "tvfdn.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+int main (int argc, char* argv[])
+{
+    const double sampleRate = 48000.0;
+    const int blockSize = argc > 1 ? std::atoi (argv[1]) : 256;
+    const double seconds = argc > 2 ? std::atof (argv[2]) : 10.0;
+    const bool tvBypassed = argc > 3 && std::strcmp (argv[3], "static") == 0;
+
+    if (blockSize <= 0 || seconds <= 0.0)
+    {
+        std::fprintf (stderr, "usage: %s [blockSize] [seconds] [tv|static]\n", argv[0]);
+        return 1;
+    }
+
+    tvfdn_engine* engine = tvfdn_create();
+
+    if (engine == nullptr || tvfdn_prepare (engine, sampleRate, blockSize, TVFDN_NUM_CHANNELS, TVFDN_NUM_CHANNELS) != TVFDN_OK)
+    {
+        std::fprintf (stderr, "could not create the engine\n");
+        return 1;
+    }
+
+    tvfdn_set_param (engine, TVFDN_PARAM_TV_BYPASSED, tvBypassed ? 1.f : 0.f);
+
+    std::vector<std::vector<float>> channels (TVFDN_NUM_CHANNELS, std::vector<float> ((size_t) blockSize));
+    std::vector<float*> pointers;
+
+    for (auto& channel : channels)
+        pointers.push_back (channel.data());
+
+    std::mt19937 random (1);
+    std::uniform_real_distribution<float> noise (-0.1f, 0.1f);
+
+    const auto numBlocks = (long) (seconds * sampleRate / blockSize);
+    double processing = 0.0;
+
+    for (long b = 0; b < numBlocks; ++b)
+    {
+        for (auto& channel : channels)
+            for (auto& sample : channel)
+                sample = noise (random);
+
+        auto start = std::chrono::steady_clock::now();
+        tvfdn_process (engine, pointers.data(), pointers.data(), blockSize);
+        processing += std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+    }
+
+    const double audio = (double) numBlocks * blockSize / sampleRate;
+
+    std::printf ("%s, block size %d: %.3f s of audio in %.3f s (%.1f %% of real time, %.1f ns per frame)\n",
+                 tvBypassed ? "static" : "time-varying", blockSize, audio, processing,
+                 100.0 * processing / audio, 1e9 * processing / ((double) numBlocks * blockSize));
+    std::printf ("kernels: %s, processing block size %d\n",
+                 tvfdn_get_kernel_variant (engine), tvfdn_get_processing_block_size (engine));
+
+    tvfdn_destroy (engine);
+    return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ ==============================================================================
+
+ Worst-case timing of FDN::process. Drives the engine like a host does, with
+ randomised parameter automation and other threads streaming through memory
+ to evict the delay lines from the caches. Every callback is timed. The
+ harness reports the p50/p99/p99.9/max times, a histogram of the load
+ relative to the deadline, and the slow callbacks by the parameter change
+ they carried.
+
+ The deadline of a callback is `budget` percent of its block duration.
+ Returns 1 if any callback missed it.
+
+ usage: tvfdn_stress_harness [blockSize|random] [seconds] [budget %] [pressure threads]
+
+ ==============================================================================
+ */
+
+#include "FDN.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// parameter changes that can land in a callback
+enum Event
+{
+    absorption = 1 << 0,    // updateFirstOrderFilter redesigns
+    oscillators = 1 << 1,   // updateOscFrequency
+    delayFactor = 1 << 2,
+    multiBand = 1 << 3,     // multi-band redesign request
+    toggle = 1 << 4,        // TV / multi-band / subband switches
+    numEvents = 5
+};
+
+static const char* const eventNames[numEvents] { "absorption", "oscillators", "delay factor", "multi-band", "switch" };
+
+struct Callback
+{
+    double seconds;
+    double deadline;
+    int events;
+};
+
+static double percentile (std::vector<double> times, double p)
+{
+    if (times.empty())
+        return 0.0;
+
+    auto index = (size_t) std::min ((double) times.size() - 1.0, std::ceil (p * (double) times.size()) - 1.0);
+    std::nth_element (times.begin(), times.begin() + (long) index, times.end());
+    return times[index];
+}
+
+// eventMask -1 takes all callbacks, 0 those without a parameter change
+static void printDistribution (const char* name, const std::vector<Callback>& callbacks, int eventMask)
+{
+    std::vector<double> times;
+    int misses = 0;
+
+    for (auto& c : callbacks)
+    {
+        if (eventMask < 0 || (eventMask == 0 ? c.events == 0 : (c.events & eventMask) != 0))
+        {
+            times.push_back (c.seconds);
+            misses += c.seconds > c.deadline ? 1 : 0;
+        }
+    }
+
+    if (times.empty())
+        return;
+
+    std::printf ("%-14s %8zu %9.1f %9.1f %9.1f %9.1f %8d\n", name, times.size(),
+                 1e6 * percentile (times, 0.5), 1e6 * percentile (times, 0.99),
+                 1e6 * percentile (times, 0.999), 1e6 * *std::max_element (times.begin(), times.end()), misses);
+}
+
+int main (int argc, char* argv[])
+{
+    const double sampleRate = 48000.0;
+    const bool randomBlockSize = argc > 1 && std::strcmp (argv[1], "random") == 0;
+    const int maxBlockSize = argc > 1 && ! randomBlockSize ? std::atoi (argv[1]) : 512;
+    const double seconds = argc > 2 ? std::atof (argv[2]) : 10.0;
+    const double budget = argc > 3 ? std::atof (argv[3]) / 100.0 : 0.5;
+    const int numPressureThreads = argc > 4 ? std::atoi (argv[4]) : 2;
+
+    if (maxBlockSize <= 0 || seconds <= 0.0 || budget <= 0.0 || numPressureThreads < 0)
+    {
+        std::fprintf (stderr, "usage: %s [blockSize|random] [seconds] [budget %%] [pressure threads]\n", argv[0]);
+        return 1;
+    }
+
+    // background cache pressure: each thread streams through 32 MB
+    std::atomic<bool> running { true };
+    std::vector<std::thread> pressure;
+
+    for (int t = 0; t < numPressureThreads; ++t)
+    {
+        pressure.emplace_back ([&running]
+        {
+            std::vector<int> memory ((size_t) 8 << 20, 1);
+
+            while (running.load (std::memory_order_relaxed))
+                for (size_t i = 0; i < memory.size(); i += 16)
+                    memory[i] += memory[(i * 7919) % memory.size()];
+        });
+    }
+
+    auto fdn = std::make_unique<FDN>();
+    dsp::ProcessSpec spec { sampleRate, (uint32) maxBlockSize, (uint32) fdn->N };
+    dsp::ProcessSpec filterSpec = spec;
+    filterSpec.numChannels = 1;
+    fdn->prepare (spec, filterSpec);
+    fdn->setNumChannels (fdn->N, fdn->N);
+
+    AudioBuffer<float> buffer ((int) fdn->N, maxBlockSize);
+    std::mt19937 random (1);
+    std::uniform_real_distribution<float> noise (-0.1f, 0.1f);
+    std::uniform_real_distribution<float> unit (0.f, 1.f);
+    std::uniform_int_distribution<int> blockSizes (1, maxBlockSize);
+
+    // smaller host blocks are usually powers of two, random ones come from variable-size hosts
+    auto nextBlockSize = [&]
+    {
+        if (! randomBlockSize)
+            return maxBlockSize;
+
+        return unit (random) < 0.5f ? 1 << std::uniform_int_distribution<int> (5, 9) (random) : blockSizes (random);
+    };
+
+    // about every 20th callback changes something, as in a dense automation lane
+    auto automate = [&]
+    {
+        int events = 0;
+
+        if (unit (random) < 0.05f) { fdn->RT_DC = 0.5f + 9.5f * unit (random); fdn->RT_CrossOverFrequency = 100.f + 7900.f * unit (random); events |= absorption; }
+        if (unit (random) < 0.05f) { fdn->osc_frequency = 0.1f + 9.9f * unit (random); fdn->spread = 0.1f + 0.9f * unit (random); events |= oscillators; }
+        if (unit (random) < 0.02f) { fdn->delayFactor = 0.5f + 4.5f * unit (random); events |= delayFactor; }
+        if (unit (random) < 0.05f) { fdn->RT_Bands[(size_t) (unit (random) * 7.99f)] = 0.5f + 9.5f * unit (random); events |= multiBand; }
+
+        if (unit (random) < 0.01f)
+        {
+            fdn->TVBypassed = unit (random) < 0.5f;
+            fdn->MultiBandAbsorption = unit (random) < 0.5f;
+            fdn->SubbandMode = unit (random) < 0.5f;
+            events |= toggle;
+        }
+
+        return events;
+    };
+
+    std::vector<Callback> callbacks;
+    callbacks.reserve ((size_t) (seconds * sampleRate / 16));
+    double audio = 0.0;
+
+    while (audio < seconds)
+    {
+        const int numSamples = nextBlockSize();
+
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            for (int i = 0; i < numSamples; ++i)
+                buffer.setSample (ch, i, noise (random));
+
+        const int events = automate();
+        dsp::AudioBlock<float> block (buffer);
+
+        auto start = std::chrono::steady_clock::now();
+        {
+            ScopedNoDenormals noDenormals;
+            fdn->process (block.getSubBlock (0, (size_t) numSamples));
+        }
+        double elapsed = std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count();
+
+        callbacks.push_back ({ elapsed, budget * numSamples / sampleRate, events });
+        audio += numSamples / sampleRate;
+    }
+
+    running = false;
+    for (auto& t : pressure)
+        t.join();
+
+    // load relative to the deadline
+    static const double edges[] { 0.1, 0.25, 0.5, 0.75, 1.0, 1.5, 2.0 };
+    static const char* const labels[] { "  <10%", "10-25%", "25-50%", "50-75%", "75-100%", "100-150%", "150-200%", "  >200%" };
+    std::vector<long> histogram (8, 0);
+
+    for (auto& c : callbacks)
+        histogram[(size_t) (std::upper_bound (std::begin (edges), std::end (edges), c.seconds / c.deadline) - std::begin (edges))]++;
+
+    std::printf ("%zu callbacks, %s block size %d, %d pressure threads, deadline %.0f %% of the block (%s kernels)\n\n",
+                 callbacks.size(), randomBlockSize ? "random" : "fixed", maxBlockSize, numPressureThreads,
+                 100.0 * budget, fdn->kernels->name);
+
+    std::printf ("%-14s %8s %9s %9s %9s %9s %8s\n", "callbacks", "count", "p50 us", "p99 us", "p99.9 us", "max us", "misses");
+    printDistribution ("all", callbacks, -1);
+    printDistribution ("no change", callbacks, 0);
+
+    for (int e = 0; e < numEvents; ++e)
+        printDistribution (eventNames[e], callbacks, 1 << e);
+
+    std::printf ("\nload vs deadline\n");
+
+    for (size_t b = 0; b < histogram.size(); ++b)
+    {
+        auto share = (double) histogram[b] / (double) callbacks.size();
+        std::printf ("%9s %8ld  %s\n", labels[b], histogram[b], std::string ((size_t) std::ceil (50.0 * share), '#').c_str());
+    }
+
+    auto missed = std::any_of (callbacks.begin(), callbacks.end(), [] (const Callback& c) { return c.seconds > c.deadline; });
+    return missed ? 1 : 0;
+}
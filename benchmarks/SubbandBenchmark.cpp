@@ -0,0 +1,88 @@
+/*
+ ==============================================================================
+
+ Cost of the subband mode against the full-rate network, through
+ FDN::process with 64 channels of noise, with and without the time-varying
+ matrix.
+
+ Budget: with the time-varying matrix (the default), the subband mode has to
+ be cheaper than the full-rate network. Returns 1 otherwise. With the static
+ matrix the dense 64 x 64 product is cheap already, so that case is only
+ reported.
+
+ usage: tvfdn_subband_benchmark [seconds of audio]
+
+ ==============================================================================
+ */
+
+#include "FDN.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+
+static constexpr double budget = 1.0;
+
+int main (int argc, char* argv[])
+{
+    const double sampleRate = 48000.0;
+    const int blockSize = 256;
+    const double seconds = argc > 1 ? std::atof (argv[1]) : 10.0;
+    const int numBlocks = (int) (seconds * sampleRate / blockSize);
+
+    auto fdn = std::make_unique<FDN>();
+    dsp::ProcessSpec spec { sampleRate, (uint32) blockSize, (uint32) fdn->N };
+    dsp::ProcessSpec filterSpec = spec;
+    filterSpec.numChannels = 1;
+    fdn->prepare (spec, filterSpec);
+
+    // a long, dark room: the case the subband mode is meant for
+    fdn->RT_DC = 6.f;
+    fdn->RT_NY = 1.f;
+
+    AudioBuffer<float> input ((int) fdn->N, blockSize);
+    AudioBuffer<float> buffer ((int) fdn->N, blockSize);
+    std::mt19937 random (1);
+    std::uniform_real_distribution<float> noise (-0.1f, 0.1f);
+
+    for (int ch = 0; ch < input.getNumChannels(); ++ch)
+        for (int i = 0; i < blockSize; ++i)
+            input.setSample (ch, i, noise (random));
+
+    auto time = [&] (bool subband, bool tvBypassed)
+    {
+        fdn->SubbandMode = subband;
+        fdn->TVBypassed = tvBypassed;
+        ScopedNoDenormals noDenormals;
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            buffer.makeCopyOf (input, true);
+            dsp::AudioBlock<float> block (buffer);
+            fdn->process (block);
+        }
+
+        return std::chrono::duration<double> (std::chrono::steady_clock::now() - start).count() / seconds;
+    };
+
+    bool ok = true;
+
+    for (bool tvBypassed : { true, false })
+    {
+        double full = time (false, tvBypassed);
+        double subband = time (true, tvBypassed);
+        double ratio = subband / full;
+        ok = ok && (tvBypassed || ratio < budget);
+
+        std::printf ("%-10s full rate: %5.1f %% of real time   subband: %5.1f %%   ratio %.2f\n",
+                     tvBypassed ? "static" : "TV", 100.0 * full, 100.0 * subband, ratio);
+    }
+
+    std::printf ("(%s kernels, decimation %zu, %zu high-band lines)\n", fdn->kernels->name, SubbandFDN::D, SubbandFDN::M);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,4242 @@
+/*
+ ==============================================================================
+ 
+ Time-varying feedback delay network engine. Independent of the plugin
+ wrapper, only needs the juce_dsp module.
+ 
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include <typeinfo>
+#include <bitset>
+#include "Matrices64.h"
+#include "Kernels.h"
+
+using namespace juce;
+using namespace std::complex_literals;
+
+class AbsorptionFilters
+{
+public:
+    
+    size_t N = 64;
+    float fs{48000};
+    
+    float RT_DC{1.f};
+    float RT_NY{1.f};
+    float delayFactor{1.f};
+    float crossover_frequency{1000.f};
+    
+    dsp::Matrix<float> DELAYS{N,1};
+    
+    // one first-order filter per line (transposed direct form II, normalised by a0), stored
+    // as structure of arrays so that a frame runs as one vectorized loop across the lines
+    std::vector<float> b0, b1, a1;
+    std::vector<float> state;
+    
+    const Kernels::Variant* kernels = &Kernels::getBaseline();
+    
+    // linear coefficient ramp towards the target, set by rampFirstOrderFilter
+    std::vector<float> targetB0, targetB1, targetA1;
+    std::vector<float> stepB0, stepB1, stepA1;
+    size_t rampRemaining{0};
+    
+    dsp::Matrix<float> filtOutput{1,N};
+ 
+    // one filter per row of _DELAYS
+    AbsorptionFilters(dsp::Matrix<float> _DELAYS)
+    {
+        DELAYS = _DELAYS;
+        N = DELAYS.getNumRows();
+        filtOutput = dsp::Matrix<float>(1, N);
+        
+        // pass-through until prepare
+        b0.assign(N, 1.f);
+        b1.assign(N, 0.f);
+        a1.assign(N, 0.f);
+        state.assign(N, 0.f);
+        targetB0 = b0;
+        targetB1 = b1;
+        targetA1 = a1;
+        stepB0.assign(N, 0.f);
+        stepB1.assign(N, 0.f);
+        stepA1.assign(N, 0.f);
+    };
+    
+    float RT602slope(float RT60,float fs){
+        return -60.f/(RT60*fs);
+    }
+    
+    float db2mag(float ydb){
+        return pow(10.f,ydb/20.f);
+    }
+    
+    void updateFirstOrderFilter(float _RT_DC, float _RT_NY, float _crossover_frequency, float _delayFactor){
+        if ( _RT_DC != RT_DC || _RT_NY != RT_NY || _crossover_frequency != crossover_frequency || _delayFactor != delayFactor){
+            
+            RT_DC = _RT_DC;
+            RT_NY = _RT_NY;
+            delayFactor = _delayFactor;
+            crossover_frequency = _crossover_frequency;
+            
+            designFirstOrderFilter();
+            jumpToTarget();
+        }
+    }
+    
+    // the same, but the coefficients glide linearly to the new design over numSamples
+    void rampFirstOrderFilter(float _RT_DC, float _RT_NY, float _crossover_frequency, float _delayFactor, size_t numSamples){
+        if ( _RT_DC != RT_DC || _RT_NY != RT_NY || _crossover_frequency != crossover_frequency || _delayFactor != delayFactor){
+            
+            RT_DC = _RT_DC;
+            RT_NY = _RT_NY;
+            delayFactor = _delayFactor;
+            crossover_frequency = _crossover_frequency;
+            
+            designFirstOrderFilter();
+            
+            if (numSamples == 0)
+            {
+                jumpToTarget();
+                return;
+            }
+            
+            const float scale = 1.f / (float) numSamples;
+            for (size_t j = 0; j < N; j++)
+            {
+                stepB0[j] = (targetB0[j] - b0[j]) * scale;
+                stepB1[j] = (targetB1[j] - b1[j]) * scale;
+                stepA1[j] = (targetA1[j] - a1[j]) * scale;
+            }
+            rampRemaining = numSamples;
+        }
+    }
+    
+    // computes the target coefficients from the current parameters and fs; no allocation
+    void designFirstOrderFilter(){
+        
+        // too high cross-over frequency leads to instable filter; fs/4 is the limit
+        if(crossover_frequency > fs/5){
+            crossover_frequency = fs/5;
+        }
+        if(crossover_frequency < 500.f){
+            crossover_frequency = 500.f;
+        }
+        
+        float omega = crossover_frequency / fs * 2* MathConstants<float>::pi;
+        
+        for(int j = 0; j < N ; j++){
+            float HDc = db2mag( delayFactor * DELAYS(j,0) * RT602slope( RT_DC, fs ) );
+            float HNyq = db2mag( delayFactor * DELAYS(j,0) * RT602slope( RT_NY, fs ) );
+        
+            float t = tan(omega);
+            float k = sqrt(HDc / HNyq);
+                    
+            // unnormalised coefficients, nb0 ... na1 (b0, b1, a1 are the members)
+            float nb0  = (t * k + 1) * HNyq;
+            float nb1  = (t * k - 1) * HNyq ;
+            float na0  = t / k + 1;
+            float na1  = t / k - 1;
+            
+            float a0inv = 1.f / na0;
+            targetB0[j] = nb0 * a0inv;
+            targetB1[j] = nb1 * a0inv;
+            targetA1[j] = na1 * a0inv;
+        }
+    }
+    
+    void jumpToTarget(){
+        b0 = targetB0;
+        b1 = targetB1;
+        a1 = targetA1;
+        rampRemaining = 0;
+    }
+    
+    
+    void prepare(const dsp::ProcessSpec& filterSpec){
+        
+        fs = filterSpec.sampleRate;
+        
+        // the coefficients depend on fs, so they are redesigned even if no parameter changed
+        designFirstOrderFilter();
+        jumpToTarget();
+        
+        reset();
+    };
+    
+    void reset(){
+        std::fill(state.begin(), state.end(), 0.f);
+    }
+    
+    // output may be input
+    void filt(const float* input, float* output)
+    {
+        if (output != input)
+            std::copy_n(input, N, output);
+        
+        kernels->firstOrderStage(output, b0.data(), b1.data(), a1.data(), state.data(), N);
+        
+        if (rampRemaining > 0)
+        {
+            if (--rampRemaining == 0)
+            {
+                jumpToTarget();
+                return;
+            }
+            
+            FloatVectorOperations::add(b0.data(), stepB0.data(), (int) N);
+            FloatVectorOperations::add(b1.data(), stepB1.data(), (int) N);
+            FloatVectorOperations::add(a1.data(), stepA1.data(), (int) N);
+        }
+    }
+    
+    dsp::Matrix<float> filt(dsp::Matrix<float> filtInput)
+    {
+        filt(filtInput.getRawDataPointer(), filtOutput.getRawDataPointer());
+        return filtOutput;
+    };
+};
+
+
+// Octave-band reverberation time control: per line a broadband gain and a cascade of
+// high-shelving biquads, one at each edge between two bands. The coefficients are
+// designed off the audio thread (see MultiBandDesignThread) and handed over through
+// two coefficient sets. They are stored as structure of arrays with the lines
+// contiguous, so each stage runs as one vectorized loop across all lines.
+class MultiBandAbsorptionFilters
+{
+public:
+    
+    static constexpr size_t numBands = 8;
+    static constexpr size_t numStages = numBands - 1;
+    
+    size_t N = 64;
+    float fs{48000};
+    
+    static constexpr std::array<float, numBands> bandFrequencies{63.f, 125.f, 250.f, 500.f, 1000.f, 2000.f, 4000.f, 8000.f};
+    static constexpr std::array<float, numBands> defaultRT{3.f, 3.f, 2.8f, 2.5f, 2.2f, 1.9f, 1.6f, 1.2f};
+    
+    dsp::Matrix<float> DELAYS{N,1};
+    
+    struct CoefficientSet
+    {
+        std::vector<float> gain;            // [line]
+        std::vector<float> b0, b1, b2, a1, a2; // [stage * N + line]
+    };
+    
+    std::array<CoefficientSet, 2> coefficientSets;
+    std::atomic<int> activeSet{0};      // only changed by the audio thread
+    std::atomic<bool> pending{false};   // the other set holds new coefficients
+    
+    std::vector<float> state1;
+    std::vector<float> state2;
+    
+    // requests from the audio thread to the designer
+    std::array<float, numBands> lastRequestedRT{};
+    float lastRequestedDelayFactor{0.f};
+    std::array<std::atomic<float>, numBands> requestedRT;
+    std::atomic<float> requestedDelayFactor{1.f};
+    std::atomic<bool> designRequested{false};
+    
+    CriticalSection designLock; // never taken by the audio thread
+    
+    const Kernels::Variant* kernels = &Kernels::getBaseline();
+    
+    // maps the target dB per band to the broadband and shelf gains, correcting
+    // for the overlap of neighbouring shelves; depends on fs only
+    std::array<std::array<double, numBands>, numBands> interactionInverse{};
+    
+    MultiBandAbsorptionFilters(dsp::Matrix<float> _DELAYS)
+    {
+        DELAYS = _DELAYS;
+        
+        for (auto& set : coefficientSets)
+        {
+            set.gain.assign(N, 1.f);
+            set.b0.assign(numStages * N, 1.f);
+            set.b1.assign(numStages * N, 0.f);
+            set.b2.assign(numStages * N, 0.f);
+            set.a1.assign(numStages * N, 0.f);
+            set.a2.assign(numStages * N, 0.f);
+        }
+        
+        state1.assign(numStages * N, 0.f);
+        state2.assign(numStages * N, 0.f);
+        
+        for (auto& rt : requestedRT)
+            rt.store(1.f);
+    }
+    
+    //############ design, off the audio thread ###################
+    
+    double edgeFrequency(size_t stage)
+    {
+        return jmin(std::sqrt((double) bandFrequencies[stage] * bandFrequencies[stage+1]), 0.45 * fs);
+    }
+    
+    // RBJ high shelf with unity slope: b0, b1, b2, a1, a2 normalised by a0
+    std::array<double, 5> highShelf(double edge, double gainDb)
+    {
+        double A = std::pow(10.0, gainDb / 40.0);
+        double w0 = MathConstants<double>::twoPi * edge / fs;
+        double cosw = std::cos(w0);
+        double alpha = std::sin(w0) / 2.0 * MathConstants<double>::sqrt2;
+        double sqrtA2alpha = 2.0 * std::sqrt(A) * alpha;
+        double a0 = (A + 1) - (A - 1) * cosw + sqrtA2alpha;
+        
+        return { A * ((A + 1) + (A - 1) * cosw + sqrtA2alpha) / a0,
+                -2 * A * ((A - 1) + (A + 1) * cosw) / a0,
+                 A * ((A + 1) + (A - 1) * cosw - sqrtA2alpha) / a0,
+                 2 * ((A - 1) - (A + 1) * cosw) / a0,
+                 ((A + 1) - (A - 1) * cosw - sqrtA2alpha) / a0 };
+    }
+    
+    void updateInteraction()
+    {
+        // column 0: broadband gain, column s+1: response of a 1 dB shelf at stage s
+        std::array<std::array<double, 2 * numBands>, numBands> m{};
+        
+        for (size_t k = 0; k < numBands; k++)
+        {
+            std::complex<double> z = std::polar(1.0, -MathConstants<double>::twoPi * bandFrequencies[k] / fs);
+            m[k][0] = 1.0;
+            
+            for (size_t s = 0; s < numStages; s++)
+            {
+                auto c = highShelf(edgeFrequency(s), 1.0);
+                auto H = (c[0] + c[1] * z + c[2] * z * z) / (1.0 + c[3] * z + c[4] * z * z);
+                m[k][s+1] = 20.0 * std::log10(std::abs(H));
+            }
+            m[k][numBands + k] = 1.0;
+        }
+        
+        // Gauss-Jordan with partial pivoting
+        for (size_t col = 0; col < numBands; col++)
+        {
+            size_t pivot = col;
+            for (size_t r = col + 1; r < numBands; r++)
+                if (std::abs(m[r][col]) > std::abs(m[pivot][col]))
+                    pivot = r;
+            std::swap(m[col], m[pivot]);
+            
+            double p = m[col][col];
+            for (auto& v : m[col])
+                v /= p;
+            
+            for (size_t r = 0; r < numBands; r++)
+            {
+                if (r == col)
+                    continue;
+                double f = m[r][col];
+                for (size_t c = 0; c < 2 * numBands; c++)
+                    m[r][c] -= f * m[col][c];
+            }
+        }
+        
+        for (size_t r = 0; r < numBands; r++)
+            for (size_t c = 0; c < numBands; c++)
+                interactionInverse[r][c] = m[r][numBands + c];
+    }
+    
+    void designSet(CoefficientSet& set, const std::array<float, numBands>& RT, float delayFactor)
+    {
+        for (size_t j = 0; j < N; j++)
+        {
+            // attenuation per pass through the line for each band, in dB
+            std::array<double, numBands> targetDb;
+            for (size_t k = 0; k < numBands; k++)
+            {
+                targetDb[k] = -60.0 * delayFactor * DELAYS(j,0) / (jmax(RT[k], 0.01f) * fs);
+            }
+            
+            std::array<double, numBands> gainDb{};
+            for (size_t r = 0; r < numBands; r++)
+                for (size_t k = 0; k < numBands; k++)
+                    gainDb[r] += interactionInverse[r][k] * targetDb[k];
+            
+            set.gain[j] = (float) std::pow(10.0, gainDb[0] / 20.0);
+            
+            for (size_t s = 0; s < numStages; s++)
+            {
+                auto c = highShelf(edgeFrequency(s), gainDb[s+1]);
+                size_t idx = s * N + j;
+                
+                set.b0[idx] = (float) c[0];
+                set.b1[idx] = (float) c[1];
+                set.b2[idx] = (float) c[2];
+                set.a1[idx] = (float) c[3];
+                set.a2[idx] = (float) c[4];
+            }
+        }
+    }
+    
+    // designs the pending request into the inactive set; false if the audio thread
+    // has not picked up the previous set yet
+    bool designPending()
+    {
+        if (! designRequested.load(std::memory_order_acquire))
+            return true;
+        
+        const ScopedLock sl(designLock);
+        
+        if (pending.load(std::memory_order_acquire))
+            return false;
+        
+        designRequested.store(false, std::memory_order_relaxed);
+        
+        std::array<float, numBands> RT;
+        for (size_t k = 0; k < numBands; k++)
+            RT[k] = requestedRT[k].load(std::memory_order_relaxed);
+        
+        designSet(coefficientSets[1 - activeSet.load(std::memory_order_relaxed)], RT, requestedDelayFactor.load(std::memory_order_relaxed));
+        pending.store(true, std::memory_order_release);
+        
+        return true;
+    }
+    
+    void prepare(const dsp::ProcessSpec& filterSpec){
+        
+        const ScopedLock sl(designLock);
+        
+        // the audio thread is not running: design straight into the active set
+        fs = filterSpec.sampleRate;
+        updateInteraction();
+        
+        std::array<float, numBands> RT;
+        for (size_t k = 0; k < numBands; k++)
+            RT[k] = requestedRT[k].load();
+        
+        designSet(coefficientSets[activeSet.load()], RT, requestedDelayFactor.load());
+        pending.store(false);
+        designRequested.store(true); // redo the other set at the new rate as well
+        
+        reset();
+    }
+    
+    //############ audio thread ###################
+    
+    void requestDesign(const std::array<float, numBands>& RT, float delayFactor)
+    {
+        if (RT != lastRequestedRT || delayFactor != lastRequestedDelayFactor)
+        {
+            lastRequestedRT = RT;
+            lastRequestedDelayFactor = delayFactor;
+            
+            for (size_t k = 0; k < numBands; k++)
+                requestedRT[k].store(RT[k], std::memory_order_relaxed);
+            requestedDelayFactor.store(delayFactor, std::memory_order_relaxed);
+            designRequested.store(true, std::memory_order_release);
+        }
+    }
+    
+    // called once per block
+    void acquireCoefficients()
+    {
+        if (pending.load(std::memory_order_acquire))
+        {
+            activeSet.store(1 - activeSet.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            pending.store(false, std::memory_order_release);
+        }
+    }
+    
+    void reset(){
+        std::fill(state1.begin(), state1.end(), 0.f);
+        std::fill(state2.begin(), state2.end(), 0.f);
+    }
+    
+    // filters one frame of N lines in place
+    void filt(float* frame)
+    {
+        const auto& set = coefficientSets[activeSet.load(std::memory_order_relaxed)];
+        
+        for (size_t j = 0; j < N; j++)
+        {
+            frame[j] *= set.gain[j];
+        }
+        
+        for (size_t s = 0; s < numStages; s++)
+        {
+            size_t o = s * N;
+            kernels->biquadStage(frame, set.b0.data() + o, set.b1.data() + o, set.b2.data() + o, set.a1.data() + o, set.a2.data() + o,
+                                 state1.data() + o, state2.data() + o, N);
+        }
+    }
+};
+
+
+class MultiBandDesignThread : public Thread
+{
+public:
+    
+    MultiBandAbsorptionFilters& filters;
+    
+    MultiBandDesignThread(MultiBandAbsorptionFilters& _filters) : Thread("FDN absorption design"), filters(_filters)
+    {
+    }
+    
+    ~MultiBandDesignThread() override
+    {
+        stopThread(1000);
+    }
+    
+    void run() override
+    {
+        // polls, so that the audio thread never has to signal
+        while (! threadShouldExit())
+        {
+            filters.designPending();
+            wait(5);
+        }
+    }
+};
+
+
+class Delays
+{
+public:
+    size_t N = 64;
+    
+    dsp::Matrix<float> DELAYS{N,1};
+    float delayFactor{1};
+    float maxDelayFactor{5.f}; // upper end of the Delay_Factor parameter range
+    
+    // all lines in one buffer, line j occupies [lineBegin[j], lineBegin[j] + lineLength[j]),
+    // so that one kernel call reads or writes a whole frame
+    std::vector<float> storage;
+    
+    // 16-bit storage halves the memory traffic once the lines outgrow the caches,
+    // at the cost of a rounding per pass through a line (see the README for the SNR)
+    enum class Precision { float32, float16, bfloat16 };
+    Precision precision = Precision::float32;
+    std::vector<uint16_t> packedStorage;  // instead of storage when not float32
+    
+    // lines in another format, allocated off the audio thread by stagePrecision until
+    // swapStaged exchanges them with the running ones
+    Precision stagedPrecision = Precision::float32;
+    std::vector<float> stagedStorage;
+    std::vector<uint16_t> stagedPackedStorage;
+    
+    std::vector<int> lineBegin;
+    std::vector<int> lineLength;
+    std::vector<int> maxDelay;
+    std::vector<int> lineDelay;     // in samples
+    std::vector<int> writePosition; // absolute index of the next write, per line
+    
+    const Kernels::Variant* kernels = &Kernels::getBaseline();
+    
+    // one line per row of _DELAYS
+    Delays(dsp::Matrix<float> _DELAYS)
+    {
+        DELAYS = _DELAYS;
+        N = DELAYS.getNumRows();
+        
+        lineBegin.resize(N);
+        lineLength.resize(N);
+        maxDelay.resize(N);
+        lineDelay.resize(N);
+        
+        // each line only needs room for its own longest delay
+        int size = 0;
+        for(int j = 0; j < N;j++){
+            maxDelay[j] = (int) std::ceil(maxDelayFactor * DELAYS(j,0));
+            lineBegin[j] = size;
+            lineLength[j] = maxDelay[j] + 1;
+            size += lineLength[j];
+        }
+        
+        storage.assign((size_t) size, 0.f);
+        writePosition = lineBegin;
+        setDelays();
+    }
+    
+    // pop before push: the sample read now was written lineDelay samples ago
+    void popSamples(float* output)
+    {
+        switch (precision)
+        {
+            case Precision::float32:
+                kernels->readLines(storage.data(), writePosition.data(), lineDelay.data(), lineBegin.data(), lineLength.data(), output, N);
+                break;
+            case Precision::float16:
+                kernels->readLinesHalf(packedStorage.data(), writePosition.data(), lineDelay.data(), lineBegin.data(), lineLength.data(), output, N);
+                break;
+            case Precision::bfloat16:
+                kernels->readLinesBFloat16(packedStorage.data(), writePosition.data(), lineDelay.data(), lineBegin.data(), lineLength.data(), output, N);
+                break;
+        }
+    }
+    
+    void pushSamples(const float* input)
+    {
+        switch (precision)
+        {
+            case Precision::float32:
+                kernels->writeLines(storage.data(), writePosition.data(), lineBegin.data(), lineLength.data(), input, N);
+                break;
+            case Precision::float16:
+                kernels->writeLinesHalf(packedStorage.data(), writePosition.data(), lineBegin.data(), lineLength.data(), input, N);
+                break;
+            case Precision::bfloat16:
+                kernels->writeLinesBFloat16(packedStorage.data(), writePosition.data(), lineBegin.data(), lineLength.data(), input, N);
+                break;
+        }
+    }
+    
+    // allocates cleared lines in the given format, not real-time safe
+    void stagePrecision(Precision _precision){
+        stagedPrecision = _precision;
+        const size_t size = (size_t) (lineBegin[N - 1] + lineLength[N - 1]);
+        
+        if (stagedPrecision == Precision::float32)
+        {
+            stagedStorage.assign(size, 0.f);
+            std::vector<uint16_t>().swap(stagedPackedStorage);
+        }
+        else
+        {
+            stagedPackedStorage.assign(size, 0);
+            std::vector<float>().swap(stagedStorage);
+        }
+    }
+    
+    // switches to the staged lines, which start from silence; the old ones stay staged
+    // until releaseStaged. No allocation, so the audio thread may call it
+    void swapStaged(){
+        precision = stagedPrecision;
+        storage.swap(stagedStorage);
+        packedStorage.swap(stagedPackedStorage);
+        writePosition = lineBegin;
+    }
+    
+    void releaseStaged(){
+        std::vector<float>().swap(stagedStorage);
+        std::vector<uint16_t>().swap(stagedPackedStorage);
+    }
+    
+    void setDelays(){
+        for(int j = 0; j < N; j++)
+        {
+            lineDelay[j] = (int) std::floor(jlimit(0.f, (float) maxDelay[j], delayFactor * DELAYS(j,0)));
+        }
+    }
+    
+    // the storage is allocated by the constructor; prepare only clears it
+    void prepare(const dsp::ProcessSpec& Spec){
+        ignoreUnused(Spec);
+        setDelays();
+        reset();
+    }
+    
+    void reset(){
+        std::fill(storage.begin(), storage.end(), 0.f);
+        std::fill(packedStorage.begin(), packedStorage.end(), 0);   // +0 in both 16-bit formats
+        writePosition = lineBegin;
+    }
+    
+    int shortestDelay() const {
+        return *std::min_element(lineDelay.begin(), lineDelay.end());
+    }
+    
+    // copies the whole history of line `from` of other (of the same length and precision)
+    // into line `to`, so that it reads back the same samples
+    void copyLine(const Delays& other, size_t from, size_t to){
+        jassert(lineLength[to] == other.lineLength[from] && precision == other.precision);
+        
+        const size_t length = (size_t) lineLength[to];
+        if (precision == Precision::float32)
+            std::copy_n(other.storage.data() + other.lineBegin[from], length, storage.data() + lineBegin[to]);
+        else
+            std::copy_n(other.packedStorage.data() + other.lineBegin[from], length, packedStorage.data() + lineBegin[to]);
+        
+        writePosition[to] = lineBegin[to] + (other.writePosition[from] - other.lineBegin[from]);
+    }
+    
+    void clearLine(size_t j){
+        if (precision == Precision::float32)
+            std::fill_n(storage.data() + lineBegin[j], lineLength[j], 0.f);
+        else
+            std::fill_n(packedStorage.data() + lineBegin[j], lineLength[j], 0);
+    }
+    
+    void updateDelayFactor(float _delayFactor){
+        if ( _delayFactor != delayFactor )
+        {
+            delayFactor = _delayFactor;
+            setDelays();
+        }
+    }
+};
+
+
+
+class TVmatrix
+{
+public:
+    
+    size_t N = 64;
+    size_t numberOfOsc = 32;
+    float fs{48000};
+    
+    // The frame goes through the dispatched real FFT kernels; the bins are interleaved
+    // (re, im) pairs, bin 0 has no imaginary part, its slot carries the real Nyquist bin
+    // instead, which the rotation (cos 1, sin 0) leaves alone
+    std::vector<float> twiddles;
+    std::vector<float> bins;
+    dsp::Matrix<float> outputFrame{1,N};
+    float osc_frequency{1.0f};
+    float osc_spread{0.1f};
+    
+    // one phase accumulator per bin; a frequency change glides linearly over rampLength
+    // samples (smoothingTime by default), with the frequencies stepped once per sample
+    static constexpr double smoothingTime = 0.05;
+    std::vector<double> phases;
+    std::vector<double> frequencies;
+    std::vector<double> targetFrequencies;
+    std::vector<double> frequencySteps;
+    size_t rampRemaining{0};
+    
+    std::vector<float> cosines; // rotation of each bin in the current sample
+    std::vector<float> sines;
+    
+    const Kernels::Variant* kernels = &Kernels::getBaseline();
+    
+    std::vector<float> randSpread { // SEB: I added a 32nd osc
+        -0.480259 , 0.600137 , -0.137172 , 0.821295 , -0.636306 , -0.472394 , -0.708922 , -0.727863 , 0.738584 , 0.159409 , 0.099720 , -0.710090 , 0.706062 , 0.244110 , -0.298095 , 0.026499 , -0.196384 , -0.848067 , -0.520168 , -0.753362 , -0.632184 , -0.520095 , -0.165466 , -0.900691 , 0.805432 , 0.889574 , -0.018272 , -0.021495 , -0.324561 , 0.800108 ,  -0.261506,  -0.161506
+    };
+    
+    // _N is a power of two, at most 64 (one spread per oscillator)
+    TVmatrix(size_t _N)
+    {
+        N = _N;
+        outputFrame = dsp::Matrix<float>(1, N);
+        numberOfOsc = N/2; // _N/2-1
+        bins.resize(N);
+        twiddles = Kernels::makeRealFFTTwiddles(N);
+        cosines.resize(N/2);
+        sines.resize(N/2);
+        phases.assign(numberOfOsc, 0.0);
+        frequencies.assign(numberOfOsc, 0.0);
+        targetFrequencies.assign(numberOfOsc, 0.0);
+        frequencySteps.assign(numberOfOsc, 0.0);
+    }
+    
+    void updateOscFrequency(float _osc_frequency, float _osc_spread){
+        rampOscFrequency(_osc_frequency, _osc_spread, (size_t) std::floor(smoothingTime * fs));
+    }
+    
+    // glides to the new frequencies over numSamples (0 jumps)
+    void rampOscFrequency(float _osc_frequency, float _osc_spread, size_t numSamples){
+        if ( _osc_frequency != osc_frequency || _osc_spread != osc_spread ){
+            osc_frequency = _osc_frequency;
+            osc_spread = _osc_spread;
+            
+            setOscFrequencies(numSamples);
+        }
+    }
+    
+    void setOscFrequencies(size_t rampLength){
+        for (size_t i = 0; i < numberOfOsc ; i++)
+        {
+            targetFrequencies[i] = (randSpread[i]*osc_spread+1)*osc_frequency;
+        }
+        
+        if (rampLength == 0)
+        {
+            frequencies = targetFrequencies;
+            rampRemaining = 0;
+            return;
+        }
+        
+        for (size_t i = 0; i < numberOfOsc ; i++)
+        {
+            frequencySteps[i] = (targetFrequencies[i] - frequencies[i]) / (double) rampLength;
+        }
+        rampRemaining = rampLength;
+    }
+    
+    
+    void  prepare(const dsp::ProcessSpec& Spec){
+        
+        fs = Spec.sampleRate;
+        
+        // the increments depend on fs: jump straight to the current frequencies
+        reset();
+    }
+    
+    // back to the phases and frequencies right after prepare
+    void reset(){
+        std::fill(phases.begin(), phases.end(), 0.0);
+        setOscFrequencies(0);
+    }
+    
+    //############ oscillation ###################
+    
+    dsp::Matrix<float> filt( dsp::Matrix<float> inputFrame){
+        filt(inputFrame.getRawDataPointer(), outputFrame.getRawDataPointer());
+        return outputFrame;
+    }
+    
+    void filt(const float* input, float* output){
+        
+        std::copy_n(input, N, bins.data());
+        kernels->realFFT(bins.data(), twiddles.data(), N);
+        
+        // the frequencies of this sample, then the phases before the advance
+        if (rampRemaining > 0)
+        {
+            if (--rampRemaining == 0)
+                frequencies = targetFrequencies;
+            else
+                for (size_t b = 0; b < numberOfOsc; b++)
+                    frequencies[b] += frequencySteps[b];
+        }
+        
+        // bin 0 (DC) stays, bins 1 .. N/2-1 rotate with their oscillator; Nyquist is left out
+        cosines[0] = 1.f;
+        sines[0] = 0.f;
+        for(size_t b = 1; b < N/2; b++){
+            cosines[b] = (float) std::cos(phases[b]);
+            sines[b] = (float) std::sin(phases[b]);
+        }
+        
+        const double scale = MathConstants<double>::twoPi / (double) fs;
+        for (size_t b = 0; b < numberOfOsc; b++)
+        {
+            double phase = phases[b] + scale * frequencies[b];
+            phases[b] = phase >= MathConstants<double>::twoPi ? phase - MathConstants<double>::twoPi : phase;
+        }
+        
+        kernels->rotateBins(bins.data(), cosines.data(), sines.data(), N/2);
+        
+        kernels->inverseRealFFT(bins.data(), twiddles.data(), N);
+        std::copy_n(bins.data(), N, output);
+    }
+    
+};
+
+
+class StabilityWatchdog
+{
+public:
+    
+    size_t N = 64;
+    const Kernels::Variant* kernels = &Kernels::getBaseline();
+    
+    // per-block accumulators over the delay outputs, as the lines are read
+    std::vector<float> linePeak;
+    std::vector<float> lineEnergy;
+    
+    // levels of the last block, readable from any thread
+    std::vector<std::atomic<float>> linePeakLevels;
+    std::vector<std::atomic<float>> lineRmsLevels;
+    std::atomic<float> gainLevel{1.f};
+    std::atomic<int> numResets{0};
+    
+    float peakLimit{8.f};       // +18 dBFS on any line: pull the feedback down
+    float resetLimit{1000.f};   // +60 dBFS or non-finite: clear the lines
+    float energyLimit{1.f};     // mean power per line above which growth counts as runaway
+    int growthBlocks{32};       // consecutive blocks of rising energy before acting
+    float gainDecay{0.8f};      // feedback gain factor per offending block
+    float gainRecovery{0.01f};  // feedback gain step per calm block
+    float minGain{0.25f};
+    
+    // a block is one call of FDN::process, however the engine splits it
+    float feedbackGain{1.f};    // gain at the start of the current block
+    float targetGain{1.f};      // gain at its end
+    float gain{1.f};            // gain reached so far within the block
+    float gainStep{0.f};        // per frame
+    float lastEnergy{0.f};
+    int growingCount{0};
+    bool resetRequested{false};
+    
+    StabilityWatchdog(size_t _N)
+    {
+        N = _N;
+        linePeak.resize(N);
+        lineEnergy.resize(N);
+        
+        // atomics cannot be copied or moved
+        std::vector<std::atomic<float>> tmpPeak(N);
+        linePeakLevels.swap(tmpPeak);
+        std::vector<std::atomic<float>> tmpRms(N);
+        lineRmsLevels.swap(tmpRms);
+    }
+    
+    void beginBlock(size_t numSamples)
+    {
+        std::fill(linePeak.begin(), linePeak.end(), 0.f);
+        std::fill(lineEnergy.begin(), lineEnergy.end(), 0.f);
+        
+        gain = feedbackGain;
+        gainStep = numSamples > 0 ? (targetGain - feedbackGain) / (float) numSamples : 0.f;
+    }
+    
+    // numFrames frame-major frames of N lines, in one vectorised pass
+    void accumulate(const float* frames, size_t numFrames)
+    {
+        kernels->trackLevels(frames, numFrames, N, linePeak.data(), lineEnergy.data());
+    }
+    
+    // evaluates the block, publishes the levels and sets the gain for the next block
+    void endBlock(size_t numSamples)
+    {
+        if (numSamples == 0)
+            return;
+        
+        float maxPeak = 0.f;
+        float energy = 0.f;
+        
+        for (size_t j = 0; j < N; j++)
+        {
+            maxPeak = jmax(maxPeak, linePeak[j]);
+            energy += lineEnergy[j];
+            
+            linePeakLevels[j].store(linePeak[j], std::memory_order_relaxed);
+            lineRmsLevels[j].store(std::sqrt(lineEnergy[j] / (float) numSamples), std::memory_order_relaxed);
+        }
+        
+        energy /= (float) (numSamples * N);
+        feedbackGain = targetGain;
+        
+        growingCount = energy > lastEnergy ? growingCount + 1 : 0;
+        lastEnergy = energy;
+        
+        if (! std::isfinite(energy) || maxPeak > resetLimit)
+        {
+            resetRequested = true;
+            numResets.fetch_add(1, std::memory_order_relaxed);
+            targetGain = minGain;
+            lastEnergy = 0.f;
+            growingCount = 0;
+        }
+        else if (maxPeak > peakLimit || (growingCount >= growthBlocks && energy > energyLimit))
+        {
+            targetGain = jmax(minGain, targetGain * gainDecay);
+        }
+        else
+        {
+            targetGain = jmin(1.f, targetGain + gainRecovery);
+        }
+        
+        gainLevel.store(targetGain, std::memory_order_relaxed);
+    }
+    
+    bool isEngaged() const
+    {
+        return feedbackGain < 1.f || targetGain < 1.f;
+    }
+};
+
+
+// Measured early reflections in front of the FDN tail: one IR per line (an IR with fewer
+// channels is repeated over the lines), convolved with zero latency by a uniformly
+// partitioned overlap-save convolution with partitions of P samples:
+//  - partition 0 runs as a direct FIR on the audio thread, frame by frame,
+//  - partition 1 runs on the audio thread at the end of each partition,
+//  - partitions 2 .. K-1 only need input that is one partition old, so they run on
+//    EarlyReflectionThread and have a whole partition to finish.
+// Partitions of an IR channel that are below -100 dB of its peak are skipped.
+// The input to the delay lines is delayed so that the FDN tail starts where the IR ends.
+// A new IR is resampled and partitioned on EarlyReflectionDesignThread into the inactive
+// one of two partition sets, which the audio thread swaps in at the start of a block.
+class EarlyReflectionConvolver
+{
+public:
+    
+    size_t N = 64;
+    float fs{48000};
+    
+    static constexpr size_t P = 64;             // partition size
+    static constexpr size_t fftSize = 2 * P;
+    static constexpr size_t numBins = P + 1;
+    static constexpr size_t specLen = 2 * numBins;
+    static constexpr float maxLengthSeconds = 0.5f;
+    
+    // everything that depends on the IR, including the state sized by it
+    struct PartitionSet
+    {
+        size_t irLength = 0;        // in samples at fs, 0 when no IR is loaded
+        size_t numIrChannels = 1;
+        size_t numPartitions = 0;
+        
+        // partition 0: headCoeffs[t * N + j], only the taps in activeTaps are non-zero
+        std::vector<float> headCoeffs;
+        std::vector<int> activeTaps;
+        
+        // partitions 1 .. K-1: spectra[(k * numIrChannels + ic) * specLen]
+        std::vector<float> spectra;
+        std::vector<char> partitionActive; // [k * numIrChannels + ic]
+        
+        // frequency-domain delay line, slot b % K holds the spectrum of input partitions
+        // b-1 and b: [(slot * N + j) * specLen]
+        std::vector<float> fdl;
+        
+        // tail send: input delayed by tailDelay frames
+        std::vector<float> sendBuffer;
+        size_t sendLength = 1;
+    };
+    
+    std::array<PartitionSet, 2> partitionSets;
+    std::atomic<int> activeSet{0};      // only changed by the audio thread
+    std::atomic<bool> pending{false};   // the other set holds a new IR
+    std::atomic<int> workerSet{-1};     // the set the worker is reading, -1 between jobs
+    
+    // the IR as given, resampled to fs when it is partitioned
+    AudioBuffer<float> impulseResponse;
+    double impulseResponseRate{48000.0};
+    std::atomic<bool> designRequested{false};
+    
+    CriticalSection designLock; // never taken by the audio thread
+    
+    // designer
+    std::vector<float> designBuffer;
+    dsp::FFT designFFT{(int) std::log2(fftSize)};
+    
+    // audio thread
+    PartitionSet* active = &partitionSets[0];
+    std::vector<float> history;     // last P input frames, frame-major
+    std::vector<float> tailFrames;  // partitions 1 .. K-1 for the running partition, frame-major
+    std::vector<float> previous;    // [j * P], planar input of the previous partition
+    std::vector<float> current;
+    std::vector<float> tailPlanar;
+    std::vector<float*> previousPointers, currentPointers, tailPointers;
+    std::vector<float> fftBuffer;
+    dsp::FFT fft{(int) std::log2(fftSize)};
+    size_t frameInPartition = 0;
+    int64 blockIndex = 0;           // partitions completed since the last restart
+    size_t sendPosition = 0;
+    size_t tailDelay = 0;
+    
+    // shared with the worker, which writes workerOut[job % 2]
+    std::vector<float> workerOut;   // [(job % 2) * N * P + j * P]
+    std::atomic<int64> requestedJob{-1};
+    std::atomic<int64> completedJob{-1};
+    std::atomic<int64> firstValidBlock{0};
+    std::atomic<int> numLateBlocks{0};
+    WaitableEvent jobReady;
+    
+    // worker
+    std::vector<float> workerBuffer;
+    dsp::FFT workerFFT{(int) std::log2(fftSize)};
+    
+    const Kernels::Variant* kernels = &Kernels::getBaseline();
+    
+    EarlyReflectionConvolver(size_t _N)
+    {
+        N = _N;
+        history.resize(P * N);
+        tailFrames.resize(P * N);
+        previous.resize(N * P);
+        current.resize(N * P);
+        tailPlanar.resize(N * P);
+        workerOut.resize(2 * N * P);
+        fftBuffer.resize(2 * fftSize);
+        designBuffer.resize(2 * fftSize);
+        workerBuffer.resize(2 * fftSize);
+        
+        for (size_t j = 0; j < N; j++)
+        {
+            previousPointers.push_back(previous.data() + j * P);
+            currentPointers.push_back(current.data() + j * P);
+            tailPointers.push_back(tailPlanar.data() + j * P);
+        }
+        
+        for (auto& set : partitionSets)
+            set.sendBuffer.resize(N);
+    }
+    
+    // audio thread
+    bool isLoaded() const
+    {
+        return active->irLength > 0;
+    }
+    
+    //############ design, off the audio thread ###################
+    
+    // an empty buffer removes the IR; any thread but the audio thread
+    void setImpulseResponse(const AudioBuffer<float>& ir, double irRate)
+    {
+        const ScopedLock sl(designLock);
+        impulseResponse.makeCopyOf(ir);
+        impulseResponseRate = irRate;
+        designRequested.store(true, std::memory_order_release);
+    }
+    
+    // resamples and partitions impulseResponse into set, with designLock held
+    void designSet(PartitionSet& set)
+    {
+        if (impulseResponse.getNumChannels() == 0 || impulseResponse.getNumSamples() == 0)
+        {
+            set.irLength = 0;
+            set.numPartitions = 0;
+            set.activeTaps.clear();
+            set.sendLength = 1;
+            set.sendBuffer.assign(N, 0.f);
+            return;
+        }
+        
+        // resample to fs and cut to the supported length
+        size_t numIrChannels = (size_t) jmin(impulseResponse.getNumChannels(), (int) N);
+        double ratio = impulseResponseRate / fs;
+        size_t irLength = jmin((size_t) std::floor((impulseResponse.getNumSamples() - 1) / ratio) + 1, (size_t) (maxLengthSeconds * fs));
+        
+        AudioBuffer<float> ir((int) numIrChannels, (int) irLength);
+        for (size_t ic = 0; ic < numIrChannels; ic++)
+        {
+            if (ratio == 1.0)
+            {
+                ir.copyFrom((int) ic, 0, impulseResponse, (int) ic, 0, (int) irLength);
+            }
+            else
+            {
+                // Lagrange reads a few samples ahead: pad the input
+                std::vector<float> padded((size_t) impulseResponse.getNumSamples() + 8, 0.f);
+                std::copy_n(impulseResponse.getReadPointer((int) ic), impulseResponse.getNumSamples(), padded.data());
+                LagrangeInterpolator interpolator;
+                interpolator.process(ratio, padded.data(), ir.getWritePointer((int) ic), (int) irLength);
+            }
+        }
+        
+        set.irLength = irLength;
+        set.numIrChannels = numIrChannels;
+        set.numPartitions = (irLength + P - 1) / P;
+        
+        // partition 0 in the time domain, per line
+        set.headCoeffs.assign(P * N, 0.f);
+        set.activeTaps.clear();
+        for (size_t t = 0; t < jmin(P, irLength); t++)
+        {
+            bool isActive = false;
+            for (size_t j = 0; j < N; j++)
+            {
+                float h = ir.getSample((int) (j % numIrChannels), (int) t);
+                set.headCoeffs[t * N + j] = h;
+                isActive = isActive || h != 0.f;
+            }
+            if (isActive)
+                set.activeTaps.push_back((int) t);
+        }
+        
+        // partitions 1 .. K-1 as spectra of the zero-padded partition
+        set.spectra.assign(set.numPartitions * numIrChannels * specLen, 0.f);
+        set.partitionActive.assign(set.numPartitions * numIrChannels, 0);
+        
+        for (size_t ic = 0; ic < numIrChannels; ic++)
+        {
+            const float* h = ir.getReadPointer((int) ic);
+            auto peak = FloatVectorOperations::findMinAndMax(h, (int) irLength);
+            float threshold = jmax(peak.getEnd(), -peak.getStart()) * 1.0e-5f; // -100 dB
+            
+            for (size_t k = 1; k < set.numPartitions; k++)
+            {
+                size_t length = jmin(P, irLength - k * P);
+                auto range = FloatVectorOperations::findMinAndMax(h + k * P, (int) length);
+                
+                if (jmax(range.getEnd(), -range.getStart()) <= threshold)
+                    continue;
+                
+                std::fill(designBuffer.begin(), designBuffer.end(), 0.f);
+                std::copy_n(h + k * P, length, designBuffer.data());
+                designFFT.performRealOnlyForwardTransform(designBuffer.data(), true);
+                std::copy_n(designBuffer.data(), specLen, set.spectra.data() + (k * numIrChannels + ic) * specLen);
+                set.partitionActive[k * numIrChannels + ic] = 1;
+            }
+        }
+        
+        set.fdl.assign(jmax(set.numPartitions, (size_t) 1) * N * specLen, 0.f);
+        
+        // enough room for the longest tail delay
+        set.sendLength = irLength + 1;
+        set.sendBuffer.assign(set.sendLength * N, 0.f);
+    }
+    
+    // partitions the pending IR into the inactive set; false if the audio thread has not
+    // picked up the previous set yet, or the worker still finishes a job on this one
+    bool designPending()
+    {
+        if (! designRequested.load(std::memory_order_acquire))
+            return true;
+        
+        const ScopedLock sl(designLock);
+        
+        if (pending.load(std::memory_order_acquire))
+            return false;
+        
+        int target = 1 - activeSet.load();
+        if (workerSet.load() == target)
+            return false;
+        
+        designRequested.store(false, std::memory_order_relaxed);
+        designSet(partitionSets[(size_t) target]);
+        pending.store(true, std::memory_order_release);
+        
+        return true;
+    }
+    
+    //############ setup, not concurrent with processing or the worker ###################
+    
+    void prepare(const dsp::ProcessSpec& Spec)
+    {
+        const ScopedLock sl(designLock);
+        
+        // the audio thread is not running: partition straight into the active set
+        fs = Spec.sampleRate;
+        designSet(*active);
+        designRequested.store(false);
+        pending.store(false);
+        
+        reset();
+    }
+    
+    void reset()
+    {
+        std::fill(history.begin(), history.end(), 0.f);
+        std::fill(tailFrames.begin(), tailFrames.end(), 0.f);
+        std::fill(previous.begin(), previous.end(), 0.f);
+        std::fill(active->sendBuffer.begin(), active->sendBuffer.end(), 0.f);
+        frameInPartition = 0;
+        sendPosition = 0;
+        blockIndex = 0;
+        requestedJob.store(-1);
+        completedJob.store(-1);
+        firstValidBlock.store(0);
+    }
+    
+    //############ audio thread ###################
+    
+    // called once per block: switches to a new IR, which starts from silence
+    void acquirePartitions()
+    {
+        if (pending.load(std::memory_order_acquire))
+        {
+            int next = 1 - activeSet.load(std::memory_order_relaxed);
+            activeSet.store(next);
+            active = &partitionSets[(size_t) next];
+            pending.store(false, std::memory_order_release);
+            
+            // the designer cleared the send of the new set
+            startOver();
+        }
+    }
+    
+    // starts from silence again after the stage was switched off
+    void restart()
+    {
+        std::fill(active->sendBuffer.begin(), active->sendBuffer.end(), 0.f);
+        startOver();
+    }
+    
+    // the worker may still be busy, so its spectra are not cleared but ignored from here on
+    void startOver()
+    {
+        std::fill(history.begin(), history.end(), 0.f);
+        std::fill(tailFrames.begin(), tailFrames.end(), 0.f);
+        std::fill(previous.begin(), previous.end(), 0.f);
+        frameInPartition = 0;
+        sendPosition = 0;
+        blockIndex += 2; // keeps job numbers increasing
+        firstValidBlock.store(blockIndex, std::memory_order_relaxed);
+    }
+    
+    // the first FDN output leaves the delay lines after the shortest line delay
+    void setTailDelay(int shortestLineDelay)
+    {
+        tailDelay = (size_t) jlimit(0, (int) active->irLength, (int) active->irLength - shortestLineDelay);
+    }
+    
+    // early reflections of one input frame, and the input for the delay lines
+    void processFrame(const float* input, float* early, float* send)
+    {
+        PartitionSet& set = *active;
+        float* frame = history.data() + frameInPartition * N;
+        std::copy_n(input, N, frame);
+        
+        // partitions 1 .. K-1, then partition 0 directly
+        std::copy_n(tailFrames.data() + frameInPartition * N, N, early);
+        
+        for (int t : set.activeTaps)
+        {
+            const float* past = history.data() + ((frameInPartition + P - (size_t) t) % P) * N;
+            FloatVectorOperations::addWithMultiply(early, set.headCoeffs.data() + (size_t) t * N, past, (int) N);
+        }
+        
+        // tail send through the delay
+        std::copy_n(input, N, set.sendBuffer.data() + sendPosition * N);
+        std::copy_n(set.sendBuffer.data() + ((sendPosition + set.sendLength - tailDelay) % set.sendLength) * N, N, send);
+        sendPosition = (sendPosition + 1) % set.sendLength;
+        
+        if (++frameInPartition == P)
+        {
+            frameInPartition = 0;
+            
+            if (set.numPartitions > 1)
+                endPartition();
+        }
+    }
+    
+    void endPartition()
+    {
+        PartitionSet& set = *active;
+        kernels->framesToPlanar(history.data(), currentPointers.data(), N, P);
+        
+        int64 m = blockIndex;
+        size_t slot = (size_t) (m % (int64) set.numPartitions);
+        
+        // the worker's part for the next partition, if it made it in time
+        int64 expected = m + 1;
+        bool workerReady = completedJob.load(std::memory_order_acquire) == expected;
+        if (! workerReady && requestedJob.load(std::memory_order_relaxed) == expected)
+            numLateBlocks.fetch_add(1, std::memory_order_relaxed);
+        
+        for (size_t j = 0; j < N; j++)
+        {
+            // overlap-save input: previous and current partition
+            std::copy_n(previous.data() + j * P, P, fftBuffer.data());
+            std::copy_n(current.data() + j * P, P, fftBuffer.data() + P);
+            std::copy_n(current.data() + j * P, P, previous.data() + j * P);
+            fft.performRealOnlyForwardTransform(fftBuffer.data(), true);
+            
+            float* X = set.fdl.data() + (slot * N + j) * specLen;
+            std::copy_n(fftBuffer.data(), specLen, X);
+            
+            float* out = tailPlanar.data() + j * P;
+            size_t ic = j % set.numIrChannels;
+            
+            if (set.numPartitions > 1 && set.partitionActive[set.numIrChannels + ic])
+            {
+                std::fill(fftBuffer.begin(), fftBuffer.end(), 0.f);
+                kernels->spectrumMultiplyAdd(fftBuffer.data(), X, set.spectra.data() + (set.numIrChannels + ic) * specLen, numBins);
+                fft.performRealOnlyInverseTransform(fftBuffer.data());
+                std::copy_n(fftBuffer.data() + P, P, out);
+            }
+            else
+            {
+                std::fill(out, out + P, 0.f);
+            }
+            
+            if (workerReady)
+                FloatVectorOperations::add(out, workerOut.data() + (size_t) (expected % 2) * N * P + j * P, (int) P);
+        }
+        
+        kernels->planarToFrames(tailPointers.data(), tailFrames.data(), N, P);
+        
+        blockIndex = m + 1;
+        
+        if (set.numPartitions > 2)
+        {
+            requestedJob.store(m + 2, std::memory_order_release);
+            jobReady.signal();
+        }
+    }
+    
+    //############ worker ###################
+    
+    // partitions 2 .. K-1 for output partition `job`; returns false if there was nothing to do
+    bool runPendingJob()
+    {
+        int64 job = requestedJob.load(std::memory_order_acquire);
+        
+        if (job <= completedJob.load(std::memory_order_relaxed))
+            return false;
+        
+        // announce the set before reading it, so that the designer leaves it alone; if the
+        // audio thread swapped meanwhile, this job belongs to the old IR and is ignored anyway
+        int s = activeSet.load();
+        workerSet.store(s);
+        if (activeSet.load() != s)
+        {
+            workerSet.store(-1);
+            return true;
+        }
+        
+        const PartitionSet& set = partitionSets[(size_t) s];
+        int64 first = firstValidBlock.load(std::memory_order_relaxed);
+        float* out = workerOut.data() + (size_t) (job % 2) * N * P;
+        
+        for (size_t j = 0; j < N; j++)
+        {
+            size_t ic = j % set.numIrChannels;
+            bool any = false;
+            std::fill(workerBuffer.begin(), workerBuffer.end(), 0.f);
+            
+            for (size_t k = 2; k < set.numPartitions; k++)
+            {
+                int64 b = job - (int64) k;
+                
+                if (b < first || ! set.partitionActive[k * set.numIrChannels + ic])
+                    continue;
+                
+                const float* X = set.fdl.data() + ((size_t) (b % (int64) set.numPartitions) * N + j) * specLen;
+                kernels->spectrumMultiplyAdd(workerBuffer.data(), X, set.spectra.data() + (k * set.numIrChannels + ic) * specLen, numBins);
+                any = true;
+            }
+            
+            if (any)
+            {
+                workerFFT.performRealOnlyInverseTransform(workerBuffer.data());
+                std::copy_n(workerBuffer.data() + P, P, out + j * P);
+            }
+            else
+            {
+                std::fill(out + j * P, out + (j + 1) * P, 0.f);
+            }
+        }
+        
+        workerSet.store(-1);
+        completedJob.store(job, std::memory_order_release);
+        return true;
+    }
+};
+
+
+class EarlyReflectionThread : public Thread
+{
+public:
+    
+    EarlyReflectionConvolver& convolver;
+    
+    EarlyReflectionThread(EarlyReflectionConvolver& _convolver) : Thread("FDN early reflections"), convolver(_convolver)
+    {
+    }
+    
+    ~EarlyReflectionThread() override
+    {
+        stopThread(1000);
+    }
+    
+    void run() override
+    {
+        // the deadline is one partition (1.3 ms at 48 kHz), too short to poll: the audio
+        // thread signals the event at the end of every partition
+        while (! threadShouldExit())
+        {
+            if (! convolver.runPendingJob())
+                convolver.jobReady.wait(20);
+        }
+    }
+};
+
+
+class EarlyReflectionDesignThread : public Thread
+{
+public:
+    
+    EarlyReflectionConvolver& convolver;
+    
+    EarlyReflectionDesignThread(EarlyReflectionConvolver& _convolver) : Thread("FDN early reflection design"), convolver(_convolver)
+    {
+    }
+    
+    ~EarlyReflectionDesignThread() override
+    {
+        stopThread(1000);
+    }
+    
+    void run() override
+    {
+        // woken by setEarlyReflections; polls only while a finished set waits for the
+        // audio thread
+        while (! threadShouldExit())
+        {
+            if (convolver.designPending())
+                wait(-1);
+            else
+                wait(5);
+        }
+    }
+};
+
+
+// Flight recorder of internal signals for field debugging. While armed, the audio thread
+// copies the selected signals of every frame into preallocated rings and overwrites the
+// oldest frames. trigger() (from any thread, or the watchdog engaging) lets it record
+// postTriggerFrames more, then the rings are frozen for TraceDumpThread, which writes
+// them to disk and arms the recorder again. The state changes go through one atomic:
+// the audio thread owns the rings while armed or triggered, the dump thread while frozen.
+// enable() allocates the rings of a new recording on its own thread and publishes it
+// through an atomic pointer; the audio thread takes it at the start of a block.
+class SignalTracer
+{
+public:
+    
+    enum Signal
+    {
+        delayOutputs = 1 << 0,
+        postAbsorption = 1 << 1,
+        postMixing = 1 << 2,        // after the TV matrix, or the static matrix
+        oscillatorPhases = 1 << 3,
+        allSignals = (1 << 4) - 1
+    };
+    static constexpr size_t numSignals = 4;
+    
+    enum State { disabled, armed, triggered, frozen };
+    
+    size_t N = 64;
+    size_t numOsc = 32;
+    std::array<size_t, numSignals> widths{};
+    
+    // the rings of one enable() and their settings
+    struct Recording
+    {
+        int signals{0};
+        size_t capacity{1};                 // frames per ring
+        size_t postTriggerFrames{0};
+        std::array<std::vector<float>, numSignals> rings;
+        File directory;
+        double sampleRate{48000.0};
+        int serial{0};
+        
+        // audio thread, or dump thread while frozen
+        size_t writeFrame{0};               // frames recorded since arming
+        size_t triggerFrame{0};
+    };
+    
+    // the recording in use, owned like its rings; the one it replaced waits in
+    // retiredRecording until the dump thread frees it
+    std::unique_ptr<Recording> recording;
+    std::atomic<Recording*> pendingRecording{nullptr};
+    std::atomic<Recording*> retiredRecording{nullptr};
+    std::atomic<int> enableSerial{0};
+    std::atomic<int> disabledSerial{0};     // enable() calls up to this one are disabled
+    
+    // audio thread
+    size_t remaining{0};
+    bool active{false};
+    
+    std::atomic<int> state{disabled};
+    std::atomic<bool> triggerRequested{false};
+    std::atomic<int> numDumps{0};
+    bool triggerOnWatchdog{true};
+    
+    SignalTracer(size_t _N, size_t _numOsc)
+    {
+        N = _N;
+        numOsc = _numOsc;
+        widths = { N, N, N, 2 * numOsc };  // the phases are recorded as cosine/sine pairs
+    }
+    
+    ~SignalTracer()
+    {
+        delete pendingRecording.load();
+        delete retiredRecording.load();
+    }
+    
+    // allocates the rings and arms them with the next block; not real-time safe, any
+    // thread but the audio thread
+    void enable(int _signals, size_t numFrames, const File& _directory, double _sampleRate)
+    {
+        auto next = std::make_unique<Recording>();
+        next->signals = _signals & allSignals;
+        next->capacity = jmax(numFrames, (size_t) 1);
+        next->postTriggerFrames = next->capacity / 2;
+        next->directory = _directory;
+        next->sampleRate = _sampleRate;
+        next->serial = enableSerial.fetch_add(1) + 1;
+        
+        for (size_t k = 0; k < numSignals; k++)
+            if (next->signals & (1 << k))
+                next->rings[k].assign(next->capacity * widths[k], 0.f);
+        
+        // replaces one the audio thread has not taken yet
+        delete pendingRecording.exchange(next.release(), std::memory_order_acq_rel);
+    }
+    
+    // any thread, also before the audio thread took the last enable(); the memory is kept
+    void disable()
+    {
+        disabledSerial.store(enableSerial.load());
+        state.store(disabled);
+    }
+    
+    // any thread; ignored unless armed, e.g. while the last trace is being written
+    void trigger()
+    {
+        if (state.load(std::memory_order_relaxed) == armed)
+            triggerRequested.store(true, std::memory_order_relaxed);
+    }
+    
+    //############ audio thread ###################
+    
+    // true if the frames of this block are recorded
+    bool beginBlock()
+    {
+        int current = state.load(std::memory_order_acquire);
+        
+        // a new recording, unless the current one is still being written out or the one
+        // before it has not been freed yet
+        if (current != frozen && pendingRecording.load(std::memory_order_relaxed) != nullptr
+            && retiredRecording.load(std::memory_order_relaxed) == nullptr)
+        {
+            if (Recording* next = pendingRecording.exchange(nullptr, std::memory_order_acquire))
+            {
+                retiredRecording.store(recording.release(), std::memory_order_release);
+                recording.reset(next);
+                triggerRequested.store(false, std::memory_order_relaxed);
+                
+                // a disable() meanwhile wins
+                int target = next->serial > disabledSerial.load() ? armed : disabled;
+                if (state.compare_exchange_strong(current, target))
+                    current = target;
+            }
+        }
+        
+        if (current == armed && triggerRequested.exchange(false, std::memory_order_relaxed))
+        {
+            recording->triggerFrame = recording->writeFrame;
+            remaining = recording->postTriggerFrames;
+            
+            if (state.compare_exchange_strong(current, triggered, std::memory_order_relaxed))
+                current = triggered;
+        }
+        
+        active = current == armed || current == triggered;
+        return active;
+    }
+    
+    void record(Signal signal, const float* frame)
+    {
+        const auto k = (size_t) findHighestSetBit((uint32) signal);
+        
+        if (active && (recording->signals & signal))
+            std::copy_n(frame, widths[k], recording->rings[k].data() + (recording->writeFrame % recording->capacity) * widths[k]);
+    }
+    
+    void recordOscillators(const float* cosines, const float* sines)
+    {
+        if (active && (recording->signals & oscillatorPhases))
+        {
+            float* slot = recording->rings[3].data() + (recording->writeFrame % recording->capacity) * widths[3];
+            std::copy_n(cosines, numOsc, slot);
+            std::copy_n(sines, numOsc, slot + numOsc);
+        }
+    }
+    
+    void endFrame()
+    {
+        if (! active)
+            return;
+        
+        recording->writeFrame++;
+        
+        int current = triggered;
+        if (remaining > 0 && --remaining == 0 && state.compare_exchange_strong(current, frozen, std::memory_order_release))
+            active = false;
+    }
+    
+    //############ dump thread ###################
+    
+    void releaseRetired()
+    {
+        delete retiredRecording.exchange(nullptr, std::memory_order_acquire);
+    }
+    
+    // writes a frozen trace and arms again; false if there was none
+    bool dumpPending()
+    {
+        if (state.load(std::memory_order_acquire) != frozen)
+            return false;
+        
+        Recording& rec = *recording;
+        const size_t numFrames = jmin(rec.writeFrame, rec.capacity);
+        const size_t firstFrame = rec.writeFrame - numFrames;
+        auto folder = rec.directory.getNonexistentChildFile("tvfdn-trace-" + Time::getCurrentTime().formatted("%Y%m%d-%H%M%S"), {}, false);
+        
+        if (folder.createDirectory().wasOk())
+        {
+            static const char* const names[numSignals] { "delay_outputs", "post_absorption", "post_mixing", "oscillator_phases" };
+            String info;
+            info << "sample_rate " << String(rec.sampleRate) << "\n"
+                 << "frames " << (int) numFrames << "\n"
+                 << "trigger_frame " << (int) (rec.triggerFrame - firstFrame) << "\n"
+                 << "format float32, little endian, interleaved frames, oldest first\n";
+            
+            std::vector<float> frame;
+            
+            for (size_t k = 0; k < numSignals; k++)
+            {
+                if (! (rec.signals & (1 << k)))
+                    continue;
+                
+                const size_t width = k == 3 ? numOsc : widths[k];
+                info << names[k] << ".raw " << (int) width << " channels\n";
+                
+                FileOutputStream stream(folder.getChildFile(String(names[k]) + ".raw"));
+                if (! stream.openedOk())
+                    continue;
+                
+                frame.resize(width);
+                
+                for (size_t f = firstFrame; f < rec.writeFrame; f++)
+                {
+                    const float* slot = rec.rings[k].data() + (f % rec.capacity) * widths[k];
+                    
+                    // phases in turns, [0, 1)
+                    if (k == 3)
+                    {
+                        for (size_t i = 0; i < numOsc; i++)
+                        {
+                            float turns = std::atan2(slot[numOsc + i], slot[i]) / MathConstants<float>::twoPi;
+                            frame[i] = turns < 0.f ? turns + 1.f : turns;
+                        }
+                    }
+                    else
+                        std::copy_n(slot, width, frame.data());
+                    
+                    stream.write(frame.data(), width * sizeof(float));
+                }
+            }
+            
+            folder.getChildFile("info.txt").replaceWithText(info);
+        }
+        
+        numDumps.fetch_add(1, std::memory_order_relaxed);
+        
+        // a fresh recording; disable() may have come in meanwhile
+        rec.writeFrame = 0;
+        triggerRequested.store(false, std::memory_order_relaxed);
+        int current = frozen;
+        state.compare_exchange_strong(current, armed, std::memory_order_release);
+        return true;
+    }
+};
+
+
+class TraceDumpThread : public Thread
+{
+public:
+    
+    SignalTracer& tracer;
+    
+    TraceDumpThread(SignalTracer& _tracer) : Thread("FDN trace dump"), tracer(_tracer)
+    {
+    }
+    
+    ~TraceDumpThread() override
+    {
+        stopThread(2000);
+    }
+    
+    void run() override
+    {
+        // polls, so that the audio thread never has to signal
+        while (! threadShouldExit())
+        {
+            tracer.releaseRetired();
+            tracer.dumpPending();
+            wait(50);
+        }
+    }
+};
+
+
+// Subband mode for long, dark reverbs (RT_NY well below RT_DC). A polyphase filter bank
+// splits the line inputs at 0.8 fs/(2D):
+//  - the low band is decimated by D and runs through a full-order network at fs/D, with
+//    the delays divided by D and the RT_DC/RT_NY absorption,
+//  - the rest runs through a short network of M lines at the full rate, which decays
+//    with RT_NY at all frequencies. Each of its lines takes a Hadamard-signed mix of
+//    N/M inputs and feeds the same N/M outputs.
+// The high band is the delayed input minus the reconstructed low band, so without the
+// networks the two bands add up to the input again. Both bands lag the main network by
+// `latency` samples. Multi-band absorption is not applied in this mode.
+class SubbandFDN
+{
+public:
+    
+    static constexpr size_t D = 4;                  // decimation of the low band
+    static constexpr size_t tapsPerPhase = 16;
+    static constexpr size_t numTaps = D * tapsPerPhase;
+    static constexpr size_t latency = numTaps - 1;  // of the split and merge, same for both bands
+    static constexpr size_t M = 16;                 // lines of the high band
+    
+    size_t N = 64;
+    float fs{48000};
+    
+    // linear-phase lowpass, Kaiser window; phase q of the interpolator weighs the low-rate
+    // frame j steps back with D * prototype[q + j * D], stored oldest first
+    std::array<float, numTaps> prototype{};
+    std::array<std::array<float, tapsPerPhase>, D> interpolation{};
+    
+    // the last numTaps input frames and the last tapsPerPhase low-rate frames, each
+    // written twice so that the newest ones are always contiguous
+    std::vector<float> inputHistory;
+    std::vector<float> lowInputs;       // decimated input
+    std::vector<float> lowOutputs;      // low network output
+    size_t inputPosition = 0;
+    size_t lowPosition = 0;
+    size_t phase = 0;                   // input samples since the last low-rate frame
+    
+    Delays lowDelays;
+    AbsorptionFilters lowAbsorption;
+    TVmatrix lowTV;
+    const float* lowMatrix;             // N x N, the static feedback matrix of the FDN
+    
+    Delays highDelays;
+    AbsorptionFilters highAbsorption;
+    TVmatrix highTV;
+    std::vector<float> highMatrix;      // M x M Hadamard
+    std::vector<float> highSigns;       // per channel, channel q * M + m belongs to line m
+    std::vector<float> highFold;        // the same, scaled to keep the input power
+    
+    std::vector<float> lowFrame, lowFilt, lowFeedback;
+    std::vector<float> highInput, highFrame, highFilt, highFeedback;
+    std::vector<float> split;
+    
+    const Kernels::Variant* kernels = &Kernels::getBaseline();
+    
+    SubbandFDN(dsp::Matrix<float> DELAYS, const float* feedbackMatrixTransposed)
+        : lowDelays(lowBandDelays(DELAYS)) , lowAbsorption(lowBandDelays(DELAYS)) , lowTV(DELAYS.getNumRows())
+        , lowMatrix(feedbackMatrixTransposed)
+        , highDelays(highBandDelays(DELAYS)) , highAbsorption(highBandDelays(DELAYS)) , highTV(M)
+    {
+        N = DELAYS.getNumRows();
+        
+        designPrototype();
+        
+        inputHistory.resize(2 * numTaps * N);
+        lowInputs.resize(2 * tapsPerPhase * N);
+        lowOutputs.resize(2 * tapsPerPhase * N);
+        
+        // Sylvester Hadamard: entry (r, c) is -1 when r & c has an odd number of bits
+        auto hadamard = [](size_t r, size_t c) { return (std::bitset<32>(r & c).count() & 1) != 0 ? -1.f : 1.f; };
+        
+        highMatrix.resize(M * M);
+        for (size_t r = 0; r < M; r++)
+            for (size_t c = 0; c < M; c++)
+                highMatrix[r * M + c] = hadamard(r, c) / std::sqrt((float) M);
+        
+        highSigns.resize(N);
+        highFold.resize(N);
+        for (size_t j = 0; j < N; j++)
+        {
+            highSigns[j] = hadamard(j / M, j % M);
+            highFold[j] = highSigns[j] / std::sqrt((float) (N / M));
+        }
+        
+        lowFrame.resize(N);
+        lowFilt.resize(N);
+        lowFeedback.resize(N);
+        highInput.resize(M);
+        highFrame.resize(M);
+        highFilt.resize(M);
+        highFeedback.resize(M);
+        split.resize(N);
+    }
+    
+    // the same delays in samples at fs/D
+    static dsp::Matrix<float> lowBandDelays(const dsp::Matrix<float>& DELAYS)
+    {
+        dsp::Matrix<float> low(DELAYS.getNumRows(), 1);
+        for (size_t j = 0; j < DELAYS.getNumRows(); j++)
+            low(j, 0) = jmax(1.f, std::round(DELAYS(j, 0) / (float) D));
+        return low;
+    }
+    
+    // every (N/M)th line of the full network
+    static dsp::Matrix<float> highBandDelays(const dsp::Matrix<float>& DELAYS)
+    {
+        dsp::Matrix<float> high(M, 1);
+        for (size_t m = 0; m < M; m++)
+            high(m, 0) = DELAYS(m * (DELAYS.getNumRows() / M), 0);
+        return high;
+    }
+    
+    void designPrototype()
+    {
+        const double cutoff = 0.8 / (2.0 * D);  // cycles per sample
+        const double beta = 5.0;                // about 50 dB stopband, 0.05 fs transition
+        const double centre = (numTaps - 1) / 2.0;
+        
+        auto besselI0 = [](double x) {
+            double sum = 1.0, term = 1.0;
+            for (int k = 1; k < 30; k++)
+            {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        };
+        
+        double sum = 0.0;
+        std::array<double, numTaps> h;
+        for (size_t k = 0; k < numTaps; k++)
+        {
+            double t = (double) k - centre;
+            double r = t / centre;
+            double sinc = 2.0 * cutoff * (t == 0.0 ? 1.0 : std::sin(MathConstants<double>::twoPi * cutoff * t) / (MathConstants<double>::twoPi * cutoff * t));
+            h[k] = sinc * besselI0(beta * std::sqrt(jmax(0.0, 1.0 - r * r))) / besselI0(beta);
+            sum += h[k];
+        }
+        
+        for (size_t k = 0; k < numTaps; k++)
+            prototype[k] = (float) (h[k] / sum);
+        
+        for (size_t q = 0; q < D; q++)
+            for (size_t j = 0; j < tapsPerPhase; j++)
+                interpolation[q][tapsPerPhase - 1 - j] = (float) D * prototype[q + j * D];
+    }
+    
+    void selectKernels(const Kernels::Variant& variant)
+    {
+        kernels = &variant;
+        lowDelays.kernels = &variant;
+        lowAbsorption.kernels = &variant;
+        lowTV.kernels = &variant;
+        highDelays.kernels = &variant;
+        highAbsorption.kernels = &variant;
+        highTV.kernels = &variant;
+    }
+    
+    void stageDelayPrecision(Delays::Precision precision)
+    {
+        lowDelays.stagePrecision(precision);
+        highDelays.stagePrecision(precision);
+    }
+    
+    void swapStagedDelays()
+    {
+        lowDelays.swapStaged();
+        highDelays.swapStaged();
+    }
+    
+    void releaseStagedDelays()
+    {
+        lowDelays.releaseStaged();
+        highDelays.releaseStaged();
+    }
+    
+    void prepare(const dsp::ProcessSpec& Spec, const dsp::ProcessSpec& filterSpec)
+    {
+        fs = Spec.sampleRate;
+        
+        dsp::ProcessSpec lowSpec = Spec;
+        lowSpec.sampleRate = Spec.sampleRate / D;
+        lowSpec.maximumBlockSize = Spec.maximumBlockSize / D + 1;
+        dsp::ProcessSpec lowFilterSpec = filterSpec;
+        lowFilterSpec.sampleRate = lowSpec.sampleRate;
+        lowFilterSpec.maximumBlockSize = lowSpec.maximumBlockSize;
+        
+        lowDelays.prepare(lowSpec);
+        lowAbsorption.prepare(lowFilterSpec);
+        lowTV.prepare(lowSpec);
+        
+        highDelays.prepare(Spec);
+        highAbsorption.prepare(filterSpec);
+        highTV.prepare(Spec);
+        
+        reset();
+    }
+    
+    void reset()
+    {
+        std::fill(inputHistory.begin(), inputHistory.end(), 0.f);
+        std::fill(lowInputs.begin(), lowInputs.end(), 0.f);
+        std::fill(lowOutputs.begin(), lowOutputs.end(), 0.f);
+        std::fill(lowFrame.begin(), lowFrame.end(), 0.f);
+        inputPosition = 0;
+        lowPosition = 0;
+        phase = 0;
+        
+        lowDelays.reset();
+        lowAbsorption.reset();
+        lowTV.reset();
+        highDelays.reset();
+        highAbsorption.reset();
+        highTV.reset();
+    }
+    
+    void update(float RT_DC, float RT_NY, float crossover, float oscFrequency, float spread, float delayFactor)
+    {
+        lowDelays.updateDelayFactor(delayFactor);
+        highDelays.updateDelayFactor(delayFactor);
+        lowAbsorption.updateFirstOrderFilter(RT_DC, RT_NY, crossover, delayFactor);
+        highAbsorption.updateFirstOrderFilter(RT_NY, RT_NY, crossover, delayFactor);
+        lowTV.updateOscFrequency(oscFrequency, spread);
+        highTV.updateOscFrequency(oscFrequency, spread);
+    }
+    
+    // the first output after an input impulse, at fs
+    int shortestDelay() const
+    {
+        return jmin(lowDelays.shortestDelay() * (int) D, highDelays.shortestDelay()) + (int) latency;
+    }
+    
+    //############ audio thread ###################
+    
+    // one frame of the N line inputs in, one frame of the N outputs out; lines takes the
+    // delay outputs: low line j (held between low-rate frames) plus the high line that
+    // feeds output j
+    void processFrame(const float* input, float* output, float* lines, float gain, bool tvBypassed, bool absorptionBypassed)
+    {
+        std::copy_n(input, N, inputHistory.data() + inputPosition * N);
+        std::copy_n(input, N, inputHistory.data() + (inputPosition + numTaps) * N);
+        
+        // input frames n - numTaps + 1 .. n, oldest first
+        const float* window = inputHistory.data() + (inputPosition + 1) * N;
+        inputPosition = (inputPosition + 1) % numTaps;
+        
+        if (++phase == D)
+        {
+            phase = 0;
+            processLowFrame(window, gain, tvBypassed, absorptionBypassed);
+        }
+        
+        // low-rate frames last - tapsPerPhase + 1 .. last, oldest first
+        const float* inputs = lowInputs.data() + lowPosition * N;
+        const float* outputs = lowOutputs.data() + lowPosition * N;
+        const float* taps = interpolation[phase].data();
+        
+        // high band: the input of numTaps - 1 samples ago minus its reconstructed low band
+        kernels->weightedFrameSum(inputs, taps, tapsPerPhase, split.data(), N);
+        FloatVectorOperations::subtract(split.data(), window, split.data(), (int) N);
+        
+        kernels->weightedFrameSum(outputs, taps, tapsPerPhase, output, N);
+        
+        processHighFrame(output, gain, tvBypassed, absorptionBypassed);
+        
+        for (size_t q = 0; q < N; q += M)
+        {
+            FloatVectorOperations::add(lines + q, lowFrame.data() + q, highFrame.data(), (int) M);
+        }
+    }
+    
+    void processLowFrame(const float* window, float gain, bool tvBypassed, bool absorptionBypassed)
+    {
+        // the prototype is symmetric, so it runs over the window in either direction
+        float* decimated = lowInputs.data() + lowPosition * N;
+        kernels->weightedFrameSum(window, prototype.data(), numTaps, decimated, N);
+        
+        lowDelays.popSamples(lowFrame.data());
+        
+        if (absorptionBypassed)
+            std::copy(lowFrame.begin(), lowFrame.end(), lowFilt.begin());
+        else
+            lowAbsorption.filt(lowFrame.data(), lowFilt.data());
+        
+        if (tvBypassed)
+            kernels->matrixProduct(lowFilt.data(), lowMatrix, lowFeedback.data(), N, N);
+        else
+            lowTV.filt(lowFilt.data(), lowFeedback.data());
+        
+        if (gain != 1.f)
+            FloatVectorOperations::multiply(lowFeedback.data(), gain, (int) N);
+        
+        // lowFilt is free again and takes the input of the lines, lowFrame keeps their output
+        FloatVectorOperations::add(lowFilt.data(), decimated, lowFeedback.data(), (int) N);
+        lowDelays.pushSamples(lowFilt.data());
+        
+        std::copy_n(decimated, N, lowInputs.data() + (lowPosition + tapsPerPhase) * N);
+        std::copy_n(lowFeedback.data(), N, lowOutputs.data() + lowPosition * N);
+        std::copy_n(lowFeedback.data(), N, lowOutputs.data() + (lowPosition + tapsPerPhase) * N);
+        lowPosition = (lowPosition + 1) % tapsPerPhase;
+    }
+    
+    // adds the high band network output to output
+    void processHighFrame(float* output, float gain, bool tvBypassed, bool absorptionBypassed)
+    {
+        std::fill(highInput.begin(), highInput.end(), 0.f);
+        for (size_t q = 0; q < N; q += M)
+        {
+            FloatVectorOperations::addWithMultiply(highInput.data(), highFold.data() + q, split.data() + q, (int) M);
+        }
+        
+        highDelays.popSamples(highFrame.data());
+        
+        if (absorptionBypassed)
+            std::copy(highFrame.begin(), highFrame.end(), highFilt.begin());
+        else
+            highAbsorption.filt(highFrame.data(), highFilt.data());
+        
+        if (tvBypassed)
+            kernels->matrixProduct(highFilt.data(), highMatrix.data(), highFeedback.data(), M, M);
+        else
+            highTV.filt(highFilt.data(), highFeedback.data());
+        
+        if (gain != 1.f)
+            FloatVectorOperations::multiply(highFeedback.data(), gain, (int) M);
+        
+        FloatVectorOperations::add(highInput.data(), highFeedback.data(), (int) M);
+        highDelays.pushSamples(highInput.data());
+        
+        for (size_t q = 0; q < N; q += M)
+        {
+            FloatVectorOperations::addWithMultiply(output + q, highSigns.data() + q, highFeedback.data(), (int) M);
+        }
+    }
+};
+
+// Reduced-order network for Adaptive Order: M of the N lines (every (N/M)th line of
+// the full network, with its delay). The feedback matrix is the sub-block of the full
+// one between those lines, made orthogonal again (its polar factor) so the network stays
+// lossless. The TV matrix has M lines and the absorption is always first order
+// (RT_DC/RT_NY). As in the high band of SubbandFDN, each line takes a Hadamard-signed
+// mix of N/M inputs and feeds the same N/M outputs.
+class ReducedFDN
+{
+public:
+    
+    static constexpr size_t M = 32;
+    
+    size_t N = 64;
+    
+    Delays delays;
+    AbsorptionFilters absorption;
+    TVmatrix tv;
+    std::vector<float> matrix;          // M x M, transposed like the one of the full network
+    std::vector<float> signs;           // per channel, channel q * M + m belongs to line m
+    std::vector<float> fold;            // the same, scaled to keep the input power
+    
+    std::vector<float> lineInput, frame, feedback;
+    
+    const Kernels::Variant* kernels = &Kernels::getBaseline();
+    
+    ReducedFDN(dsp::Matrix<float> DELAYS, const float* feedbackMatrixTransposed)
+        : delays(reducedDelays(DELAYS)) , absorption(reducedDelays(DELAYS)) , tv(M)
+    {
+        N = DELAYS.getNumRows();
+        
+        matrix = reduceMatrix(feedbackMatrixTransposed, N);
+        
+        // Sylvester Hadamard: entry (r, c) is -1 when r & c has an odd number of bits
+        auto hadamard = [](size_t r, size_t c) { return (std::bitset<32>(r & c).count() & 1) != 0 ? -1.f : 1.f; };
+        
+        signs.resize(N);
+        fold.resize(N);
+        for (size_t j = 0; j < N; j++)
+        {
+            signs[j] = hadamard(j / M, j % M);
+            fold[j] = signs[j] / std::sqrt((float) (N / M));
+        }
+        
+        lineInput.resize(M);
+        frame.resize(M);
+        feedback.resize(M);
+    }
+    
+    // line of the full network that line m stands in for
+    size_t fullLine(size_t m) const
+    {
+        return m * (N / M);
+    }
+    
+    // the M x M block of the lines kept, made orthogonal again; transposed like the input
+    static std::vector<float> reduceMatrix(const float* feedbackMatrixTransposed, size_t N)
+    {
+        std::vector<double> block(M * M);
+        for (size_t r = 0; r < M; r++)
+            for (size_t c = 0; c < M; c++)
+                block[r * M + c] = feedbackMatrixTransposed[r * (N / M) * N + c * (N / M)];
+        
+        orthogonalise(block, M);
+        return std::vector<float>(block.begin(), block.end());
+    }
+    
+    static dsp::Matrix<float> reducedDelays(const dsp::Matrix<float>& DELAYS)
+    {
+        dsp::Matrix<float> reduced(M, 1);
+        for (size_t m = 0; m < M; m++)
+            reduced(m, 0) = DELAYS(m * (DELAYS.getNumRows() / M), 0);
+        return reduced;
+    }
+    
+    // polar factor of the n x n matrix X, in place, by Bjorck iterations
+    // X <- X (3 I - X^T X) / 2; converges for singular values in (0, sqrt 3)
+    static void orthogonalise(std::vector<double>& X, size_t n)
+    {
+        std::vector<double> gram(n * n), next(n * n);
+        
+        for (int iteration = 0; iteration < 500; iteration++)
+        {
+            double error = 0.0;
+            
+            for (size_t r = 0; r < n; r++)
+            {
+                for (size_t c = 0; c < n; c++)
+                {
+                    double sum = 0.0;
+                    for (size_t k = 0; k < n; k++)
+                        sum += X[k * n + r] * X[k * n + c];
+                    
+                    gram[r * n + c] = (r == c ? 3.0 : 0.0) - sum;
+                    error = jmax(error, std::abs((r == c ? 1.0 : 0.0) - sum));
+                }
+            }
+            
+            if (error < 1e-12)
+                break;
+            
+            for (size_t r = 0; r < n; r++)
+            {
+                for (size_t c = 0; c < n; c++)
+                {
+                    double sum = 0.0;
+                    for (size_t k = 0; k < n; k++)
+                        sum += X[r * n + k] * gram[k * n + c];
+                    
+                    next[r * n + c] = 0.5 * sum;
+                }
+            }
+            
+            X.swap(next);
+        }
+    }
+    
+    void selectKernels(const Kernels::Variant& variant)
+    {
+        kernels = &variant;
+        delays.kernels = &variant;
+        absorption.kernels = &variant;
+        tv.kernels = &variant;
+    }
+    
+    void stageDelayPrecision(Delays::Precision precision)
+    {
+        delays.stagePrecision(precision);
+    }
+    
+    void swapStagedDelays()
+    {
+        delays.swapStaged();
+    }
+    
+    void releaseStagedDelays()
+    {
+        delays.releaseStaged();
+    }
+    
+    void prepare(const dsp::ProcessSpec& Spec, const dsp::ProcessSpec& filterSpec)
+    {
+        delays.prepare(Spec);
+        absorption.prepare(filterSpec);
+        tv.prepare(Spec);
+    }
+    
+    void reset()
+    {
+        delays.reset();
+        absorption.reset();
+        tv.reset();
+    }
+    
+    void update(float RT_DC, float RT_NY, float crossover, float oscFrequency, float spread, float delayFactor)
+    {
+        delays.updateDelayFactor(delayFactor);
+        absorption.updateFirstOrderFilter(RT_DC, RT_NY, crossover, delayFactor);
+        tv.updateOscFrequency(oscFrequency, spread);
+    }
+    
+    // continues from the lines of the full network
+    void takeOver(const Delays& full)
+    {
+        for (size_t m = 0; m < M; m++)
+            delays.copyLine(full, fullLine(m), m);
+        
+        absorption.reset();
+    }
+    
+    // hands the lines back; the lines the reduced network does not have start from silence
+    void handBack(Delays& full) const
+    {
+        for (size_t j = 0; j < N; j++)
+        {
+            if (j % (N / M) == 0)
+                full.copyLine(delays, j / (N / M), j);
+            else
+                full.clearLine(j);
+        }
+    }
+    
+    //############ audio thread ###################
+    
+    // one frame of the N line inputs in, one frame of the N outputs out; lines takes the
+    // delay outputs at the lines of the full network they stand in for, 0 elsewhere
+    void processFrame(const float* input, float* output, float* lines, bool applyGain, float gain, bool tvBypassed, bool absorptionBypassed)
+    {
+        std::fill(lineInput.begin(), lineInput.end(), 0.f);
+        for (size_t q = 0; q < N; q += M)
+        {
+            FloatVectorOperations::addWithMultiply(lineInput.data(), fold.data() + q, input + q, (int) M);
+        }
+        
+        delays.popSamples(frame.data());
+        
+        std::fill_n(lines, N, 0.f);
+        for (size_t m = 0; m < M; m++)
+            lines[m * (N / M)] = frame[m];
+        
+        if (! absorptionBypassed)
+            absorption.filt(frame.data(), frame.data());
+        
+        if (tvBypassed)
+            kernels->matrixProduct(frame.data(), matrix.data(), feedback.data(), M, M);
+        else
+            tv.filt(frame.data(), feedback.data());
+        
+        if (applyGain)
+            FloatVectorOperations::multiply(feedback.data(), gain, (int) M);
+        
+        FloatVectorOperations::add(lineInput.data(), feedback.data(), (int) M);
+        delays.pushSamples(lineInput.data());
+        
+        for (size_t q = 0; q < N; q += M)
+        {
+            FloatVectorOperations::multiply(output + q, signs.data() + q, feedback.data(), (int) M);
+        }
+    }
+};
+
+
+// Glides the static feedback matrix from its current value A to a target B through
+// orthogonal matrices only, so that the network stays lossless on the way. Off the
+// audio thread, A^T B is split into the planes it rotates: A^T B = Q R Q^T, R turning
+// plane k (columns 2k and 2k + 1 of Q) by angles[k] (a real Schur form, found from the
+// eigenvectors of the symmetric part). The matrix at t in [0, 1] is A Q R(t) Q^T: a
+// frame costs two N x N products and the rotation of the planes, a block the sines and
+// cosines of t times the angles. A target of determinant -1 is not reachable by
+// rotations; its last column is negated, which flips the polarity of one line.
+class FeedbackMatrixMorph
+{
+public:
+    
+    enum State { idle, designing, ready, morphing };
+    
+    size_t N = 64;
+    std::atomic<int> state{idle};
+    std::atomic<float> progress{1.f};       // of the last morph, for the telemetry
+    
+    // the request; requestLock is never taken by the audio thread
+    CriticalSection requestLock;
+    std::vector<float> requestedTarget;
+    double requestedSeconds{1.0};
+    bool requested{false};
+    
+    // the path, written by the design thread while idle or designing
+    const float* current;                   // A, transposed as in FDN; only read while idle
+    std::vector<float> basis;               // Q: matrixProduct with it gives Q^T x
+    std::vector<float> mixing;              // (A Q)^T: matrixProduct with it gives A Q z
+    std::vector<float> angles;
+    size_t numPlanes{0};
+    std::vector<float> targetMatrix;        // B, row-major as the imported matrices
+    std::vector<float> targetTransposed;
+    std::vector<float> reducedTarget;       // for ReducedFDN::matrix
+    double seconds{1.0};
+    
+    // audio thread
+    bool active{false};
+    size_t length{1};
+    size_t position{0};
+    std::vector<float> cosines, sines, planes;
+    
+    FeedbackMatrixMorph(size_t _N, const float* feedbackMatrixTransposed) : N(_N), current(feedbackMatrixTransposed)
+    {
+        basis.resize(N * N);
+        mixing.resize(N * N);
+        angles.resize(N / 2);
+        targetMatrix.resize(N * N);
+        targetTransposed.resize(N * N);
+        cosines.resize(N / 2);
+        sines.resize(N / 2);
+        planes.resize(N);
+    }
+    
+    // largest entry of X^T X - I
+    static double orthogonalityError(const std::vector<double>& X, size_t n)
+    {
+        double error = 0.0;
+        for (size_t r = 0; r < n; r++)
+        {
+            for (size_t c = 0; c < n; c++)
+            {
+                double sum = 0.0;
+                for (size_t k = 0; k < n; k++)
+                    sum += X[k * n + r] * X[k * n + c];
+                
+                error = jmax(error, std::abs((r == c ? 1.0 : 0.0) - sum));
+            }
+        }
+        return error;
+    }
+    
+    // sign of the determinant, by elimination with partial pivoting
+    static double determinantSign(std::vector<double> X, size_t n)
+    {
+        double sign = 1.0;
+        for (size_t c = 0; c < n; c++)
+        {
+            size_t pivot = c;
+            for (size_t r = c + 1; r < n; r++)
+                if (std::abs(X[r * n + c]) > std::abs(X[pivot * n + c]))
+                    pivot = r;
+            
+            if (X[pivot * n + c] == 0.0)
+                return 0.0;
+            
+            if (pivot != c)
+            {
+                for (size_t k = 0; k < n; k++)
+                    std::swap(X[c * n + k], X[pivot * n + k]);
+                sign = -sign;
+            }
+            
+            if (X[c * n + c] < 0.0)
+                sign = -sign;
+            
+            for (size_t r = c + 1; r < n; r++)
+            {
+                const double factor = X[r * n + c] / X[c * n + c];
+                for (size_t k = c; k < n; k++)
+                    X[r * n + k] -= factor * X[c * n + k];
+            }
+        }
+        return sign;
+    }
+    
+    // eigenvalues and eigenvectors (the columns of V) of the symmetric n x n matrix H,
+    // which is destroyed, by cyclic Jacobi rotations
+    static void symmetricEigen(std::vector<double>& H, std::vector<double>& V, std::vector<double>& values, size_t n)
+    {
+        V.assign(n * n, 0.0);
+        for (size_t i = 0; i < n; i++)
+            V[i * n + i] = 1.0;
+        
+        for (int sweep = 0; sweep < 100; sweep++)
+        {
+            double off = 0.0;
+            for (size_t p = 0; p < n; p++)
+                for (size_t q = p + 1; q < n; q++)
+                    off += H[p * n + q] * H[p * n + q];
+            
+            if (off < 1e-30)
+                break;
+            
+            for (size_t p = 0; p < n; p++)
+            {
+                for (size_t q = p + 1; q < n; q++)
+                {
+                    const double hpq = H[p * n + q];
+                    if (std::abs(hpq) < 1e-300)
+                        continue;
+                    
+                    const double theta = (H[q * n + q] - H[p * n + p]) / (2.0 * hpq);
+                    const double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+                    const double c = 1.0 / std::sqrt(t * t + 1.0);
+                    const double s = t * c;
+                    
+                    for (size_t k = 0; k < n; k++)
+                    {
+                        const double kp = H[k * n + p], kq = H[k * n + q];
+                        H[k * n + p] = c * kp - s * kq;
+                        H[k * n + q] = s * kp + c * kq;
+                    }
+                    for (size_t k = 0; k < n; k++)
+                    {
+                        const double pk = H[p * n + k], qk = H[q * n + k];
+                        H[p * n + k] = c * pk - s * qk;
+                        H[q * n + k] = s * pk + c * qk;
+                    }
+                    for (size_t k = 0; k < n; k++)
+                    {
+                        const double kp = V[k * n + p], kq = V[k * n + q];
+                        V[k * n + p] = c * kp - s * kq;
+                        V[k * n + q] = s * kp + c * kq;
+                    }
+                }
+            }
+        }
+        
+        values.resize(n);
+        for (size_t i = 0; i < n; i++)
+            values[i] = H[i * n + i];
+    }
+    
+    // message thread: false unless target (N x N, row-major) is orthogonal. A request
+    // made during a morph starts where that one ends.
+    bool request(const float* target, double _seconds)
+    {
+        std::vector<double> B(target, target + N * N);
+        if (! (_seconds >= 0.0) || orthogonalityError(B, N) > 1e-3)
+            return false;
+        
+        const ScopedLock lock(requestLock);
+        requestedTarget.assign(target, target + N * N);
+        requestedSeconds = _seconds;
+        requested = true;
+        return true;
+    }
+    
+    // design thread
+    bool designPending()
+    {
+        if (state.load(std::memory_order_acquire) != idle)
+            return false;
+        
+        std::vector<double> B;
+        {
+            const ScopedLock lock(requestLock);
+            if (! requested)
+                return false;
+            
+            B.assign(requestedTarget.begin(), requestedTarget.end());
+            seconds = requestedSeconds;
+            requested = false;
+        }
+        
+        state.store(designing, std::memory_order_relaxed);
+        design(B);
+        state.store(ready, std::memory_order_release);
+        return true;
+    }
+    
+    void design(std::vector<double>& B)
+    {
+        const size_t n = N;
+        
+        std::vector<double> A(n * n);
+        for (size_t r = 0; r < n; r++)
+            for (size_t c = 0; c < n; c++)
+                A[r * n + c] = current[c * n + r];
+        
+        // both are orthogonal to float precision only, the split below wants double
+        ReducedFDN::orthogonalise(A, n);
+        ReducedFDN::orthogonalise(B, n);
+        
+        if (determinantSign(A, n) * determinantSign(B, n) < 0.0)
+            for (size_t r = 0; r < n; r++)
+                B[r * n + n - 1] = -B[r * n + n - 1];
+        
+        // C = A^T B, its symmetric part holds cos(angle) as eigenvalues, the skew part
+        // maps u of a plane to sin(angle) v
+        std::vector<double> C(n * n, 0.0), H(n * n), S(n * n);
+        for (size_t k = 0; k < n; k++)
+            for (size_t r = 0; r < n; r++)
+                for (size_t c = 0; c < n; c++)
+                    C[r * n + c] += A[k * n + r] * B[k * n + c];
+        
+        for (size_t r = 0; r < n; r++)
+        {
+            for (size_t c = 0; c < n; c++)
+            {
+                H[r * n + c] = 0.5 * (C[r * n + c] + C[c * n + r]);
+                S[r * n + c] = 0.5 * (C[r * n + c] - C[c * n + r]);
+            }
+        }
+        
+        std::vector<double> V, values;
+        symmetricEigen(H, V, values, n);
+        
+        std::vector<size_t> order(n);
+        for (size_t i = 0; i < n; i++)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return values[a] < values[b]; });
+        
+        std::vector<std::vector<double>> columns;       // of Q, planes first
+        std::vector<std::vector<double>> fixed;
+        std::vector<double> planeAngles;
+        
+        auto dot = [n](const std::vector<double>& a, const std::vector<double>& b)
+        {
+            double sum = 0.0;
+            for (size_t k = 0; k < n; k++)
+                sum += a[k] * b[k];
+            return sum;
+        };
+        
+        // x without its components along the columns chosen so far, normalised; false if little is left
+        auto complement = [&](std::vector<double>& x)
+        {
+            for (int pass = 0; pass < 2; pass++)
+            {
+                for (auto& column : columns)
+                {
+                    const double projection = dot(x, column);
+                    for (size_t k = 0; k < n; k++)
+                        x[k] -= projection * column[k];
+                }
+            }
+            
+            const double norm = std::sqrt(dot(x, x));
+            if (norm < 0.5)
+                return false;
+            
+            for (auto& value : x)
+                value /= norm;
+            return true;
+        };
+        
+        for (size_t i = 0; i < n;)
+        {
+            // eigenvalues within 1e-9 belong to one eigenspace
+            size_t end = i + 1;
+            while (end < n && values[order[end]] - values[order[i]] < 1e-9)
+                end++;
+            
+            std::vector<std::vector<double>> space;
+            for (size_t e = i; e < end; e++)
+            {
+                space.emplace_back(n);
+                for (size_t k = 0; k < n; k++)
+                    space.back()[k] = V[k * n + order[e]];
+            }
+            
+            const double cosine = values[order[i]];
+            const bool halfTurn = cosine < -1.0 + 1e-9;
+            i = end;
+            
+            if (cosine > 1.0 - 1e-9)
+            {
+                fixed.insert(fixed.end(), space.begin(), space.end());
+                continue;
+            }
+            
+            // u is any vector of the space left, v follows from it; for half turns any
+            // other vector of the space will do
+            for (size_t next = 0; next < space.size(); next++)
+            {
+                std::vector<double> u = space[next];
+                if (! complement(u))
+                    continue;
+                
+                std::vector<double> v(n, 0.0);
+                bool found = false;
+                
+                if (halfTurn)
+                {
+                    for (size_t other = next + 1; other < space.size() && ! found; other++)
+                    {
+                        v = space[other];
+                        const double projection = dot(v, u);
+                        for (size_t k = 0; k < n; k++)
+                            v[k] -= projection * u[k];
+                        found = complement(v);
+                    }
+                }
+                else
+                {
+                    for (size_t r = 0; r < n; r++)
+                        for (size_t c = 0; c < n; c++)
+                            v[r] += S[r * n + c] * u[c];
+                    
+                    const double projection = dot(v, u);
+                    for (size_t k = 0; k < n; k++)
+                        v[k] -= projection * u[k];
+                    
+                    const double norm = std::sqrt(dot(v, v));
+                    if (norm > 0.0)
+                    {
+                        for (auto& value : v)
+                            value /= norm;
+                        found = complement(v);
+                    }
+                }
+                
+                if (! found)
+                {
+                    jassertfalse;   // an odd space, not a rotation
+                    fixed.push_back(u);
+                    continue;
+                }
+                
+                std::vector<double> Cu(n, 0.0);
+                for (size_t r = 0; r < n; r++)
+                    for (size_t c = 0; c < n; c++)
+                        Cu[r] += C[r * n + c] * u[c];
+                
+                planeAngles.push_back(halfTurn ? MathConstants<double>::pi : std::atan2(dot(v, Cu), dot(u, Cu)));
+                columns.push_back(u);
+                columns.push_back(v);
+            }
+        }
+        
+        numPlanes = planeAngles.size();
+        columns.insert(columns.end(), fixed.begin(), fixed.end());
+        
+        // the split is checked: should it fail, the path stays at A and jumps to B at its end
+        double error = columns.size() == n ? 0.0 : 1.0;
+        if (error == 0.0)
+        {
+            std::vector<double> rotated(n);
+            for (size_t c = 0; c < n && error < 1e-4; c++)
+            {
+                // column c of Q R Q^T against that of C
+                std::fill(rotated.begin(), rotated.end(), 0.0);
+                for (size_t k = 0; k < n; k++)
+                {
+                    const double z = columns[k][c];
+                    if (k < 2 * numPlanes)
+                    {
+                        const double angle = planeAngles[k / 2];
+                        const double zu = columns[k & ~(size_t) 1][c], zv = columns[k | 1][c];
+                        const double w = (k & 1) == 0 ? std::cos(angle) * zu - std::sin(angle) * zv
+                                                      : std::sin(angle) * zu + std::cos(angle) * zv;
+                        for (size_t r = 0; r < n; r++)
+                            rotated[r] += columns[k][r] * w;
+                    }
+                    else
+                    {
+                        for (size_t r = 0; r < n; r++)
+                            rotated[r] += columns[k][r] * z;
+                    }
+                }
+                
+                for (size_t r = 0; r < n; r++)
+                    error = jmax(error, std::abs(rotated[r] - C[r * n + c]));
+            }
+        }
+        
+        if (error >= 1e-4)
+        {
+            jassertfalse;
+            numPlanes = 0;
+            columns.assign(n, std::vector<double>(n, 0.0));
+            for (size_t k = 0; k < n; k++)
+                columns[k][k] = 1.0;
+        }
+        
+        for (size_t k = 0; k < numPlanes; k++)
+            angles[k] = (float) planeAngles[k];
+        
+        for (size_t r = 0; r < n; r++)
+        {
+            for (size_t c = 0; c < n; c++)
+            {
+                basis[r * n + c] = (float) columns[c][r];
+                
+                // (A Q)(c, r)
+                double sum = 0.0;
+                for (size_t k = 0; k < n; k++)
+                    sum += A[c * n + k] * columns[r][k];
+                mixing[r * n + c] = (float) sum;
+                
+                targetMatrix[r * n + c] = (float) B[r * n + c];
+                targetTransposed[r * n + c] = (float) B[c * n + r];
+            }
+        }
+        
+        reducedTarget = ReducedFDN::reduceMatrix(targetTransposed.data(), n);
+    }
+    
+    // audio thread, at the start of a block of numFrames: starts a designed morph and
+    // sets the angles the block is processed with (those at its end)
+    void beginBlock(size_t numFrames, double sampleRate)
+    {
+        if (! active && state.load(std::memory_order_acquire) == ready)
+        {
+            length = jmax((size_t) 1, (size_t) (seconds * sampleRate));
+            position = 0;
+            active = true;
+            state.store(morphing, std::memory_order_relaxed);
+        }
+        
+        if (! active)
+            return;
+        
+        position = jmin(length, position + numFrames);
+        const double t = (double) position / (double) length;
+        
+        for (size_t k = 0; k < numPlanes; k++)
+        {
+            cosines[k] = (float) std::cos(t * angles[k]);
+            sines[k] = (float) std::sin(t * angles[k]);
+        }
+        
+        progress.store((float) t, std::memory_order_relaxed);
+    }
+    
+    // the block processed reached the target; the caller installs it and calls finish
+    bool finished() const
+    {
+        return active && position >= length;
+    }
+    
+    void finish()
+    {
+        active = false;
+        state.store(idle, std::memory_order_release);
+    }
+    
+    forcedinline void apply(const float* input, float* output, const Kernels::Variant& kernels)
+    {
+        kernels.matrixProduct(input, basis.data(), planes.data(), N, N);
+        kernels.rotateBins(planes.data(), cosines.data(), sines.data(), numPlanes);
+        kernels.matrixProduct(planes.data(), mixing.data(), output, N, N);
+    }
+};
+
+
+class MorphDesignThread : public Thread
+{
+public:
+    
+    FeedbackMatrixMorph& morph;
+    
+    MorphDesignThread(FeedbackMatrixMorph& _morph) : Thread("FDN matrix morph design"), morph(_morph)
+    {
+    }
+    
+    ~MorphDesignThread() override
+    {
+        stopThread(1000);
+    }
+    
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            morph.designPending();
+            wait(5);
+        }
+    }
+};
+
+
+// Picks the kernel variant and the processing block size by timing a scratch copy of the
+// full-rate network (delay lines, first-order absorption, TV or static mixing, host I/O
+// transposes) on silence, for every supported variant (or only the one forced with
+// TVFDN_KERNELS) and every power-of-two block size from 32 up to the host block. Runs on
+// KernelTuneThread, so no prepare or process call waits for it; the result is published
+// as one atomic word that FDN::process installs at the start of a block.
+class KernelTuner
+{
+public:
+    
+    size_t N = 64;
+    
+    // written by FDN::prepare, read by the tuning thread
+    std::atomic<int> requestedBlockSize{0};
+    std::atomic<double> requestedSampleRate{48000.0};
+    std::atomic<bool> requestedTVBypassed{false};
+    std::atomic<bool> requestedAbsorptionBypassed{false};
+    
+    // block size << 8 | index into Kernels::variants, 0 until the first tuning finished
+    std::atomic<int64_t> result{0};
+    
+    Delays delays;
+    AbsorptionFilters absorption;
+    TVmatrix tv;
+    std::vector<float> matrix;          // copy of the static feedback matrix (transposed storage)
+    std::vector<float> inFrames;
+    std::vector<float> outFrames;
+    std::vector<float> planar;
+    std::vector<const float*> inputPointers;
+    std::vector<float*> outputPointers;
+    alignas(64) std::array<float, 64> frame{};
+    alignas(64) std::array<float, 64> mixed{};
+    
+    KernelTuner(dsp::Matrix<float> DELAYS, const float* feedbackMatrixTransposed, size_t _N)
+        : N(_N), delays(DELAYS), absorption(DELAYS), tv(_N), matrix(feedbackMatrixTransposed, feedbackMatrixTransposed + _N * _N)
+    {
+    }
+    
+    // any thread: tunes (again) for host blocks of up to maxBlockSize
+    void request(size_t maxBlockSize, double sampleRate, bool tvBypassed, bool absorptionBypassed)
+    {
+        requestedSampleRate.store(sampleRate);
+        requestedTVBypassed.store(tvBypassed);
+        requestedAbsorptionBypassed.store(absorptionBypassed);
+        requestedBlockSize.store((int) maxBlockSize);
+    }
+    
+    static int64_t pack(size_t variantIndex, size_t blockSize)
+    {
+        return ((int64_t) blockSize << 8) | (int64_t) variantIndex;
+    }
+    
+    static const Kernels::Variant& unpackVariant(int64_t packed)
+    {
+        return Kernels::variants[(size_t) (packed & 0xff)];
+    }
+    
+    static size_t unpackBlockSize(int64_t packed)
+    {
+        return (size_t) (packed >> 8);
+    }
+    
+    // tuning thread; returns true if it tuned
+    bool tunePending()
+    {
+        const int blockSize = requestedBlockSize.exchange(0);
+        
+        if (blockSize <= 0)
+            return false;
+        
+        tune((size_t) blockSize);
+        return true;
+    }
+    
+    void tune(size_t maxBlockSize)
+    {
+        const double sampleRate = requestedSampleRate.load();
+        const bool tvBypassed = requestedTVBypassed.load();
+        const bool absorptionBypassed = requestedAbsorptionBypassed.load();
+        
+        dsp::ProcessSpec spec{sampleRate, (uint32) maxBlockSize, (uint32) N};
+        dsp::ProcessSpec filterSpec{sampleRate, (uint32) maxBlockSize, 1};
+        delays.prepare(spec);
+        absorption.prepare(filterSpec);
+        tv.prepare(spec);
+        
+        inFrames.assign(maxBlockSize * N, 0.f);
+        outFrames.assign(maxBlockSize * N, 0.f);
+        planar.assign(maxBlockSize * N, 0.f);
+        inputPointers.resize(N);
+        outputPointers.resize(N);
+        for (size_t c = 0; c < N; c++)
+        {
+            inputPointers[c] = planar.data() + c * maxBlockSize;
+            outputPointers[c] = planar.data() + c * maxBlockSize;
+        }
+        
+        auto* forced = Kernels::getOverride();
+        size_t bestVariant = 0;
+        size_t bestBlockSize = maxBlockSize;
+        double bestTime = std::numeric_limits<double>::max();
+        
+        for (size_t v = 0; v < std::size(Kernels::variants); v++)
+        {
+            auto& variant = Kernels::variants[v];
+            
+            if (! variant.isSupported() || (forced != nullptr && forced != &variant))
+                continue;
+            
+            delays.kernels = &variant;
+            absorption.kernels = &variant;
+            tv.kernels = &variant;
+            
+            for (size_t blockSize = jmin((size_t) 32, maxBlockSize); ; blockSize = jmin(2 * blockSize, maxBlockSize))
+            {
+                double time = timeBlocks(variant, blockSize, tvBypassed, absorptionBypassed);
+                
+                if (time < bestTime)
+                {
+                    bestTime = time;
+                    bestVariant = v;
+                    bestBlockSize = blockSize;
+                }
+                
+                if (blockSize == maxBlockSize)
+                    break;
+            }
+        }
+        
+        result.store(pack(bestVariant, bestBlockSize));
+    }
+    
+    // seconds per frame, best of three runs over at least 256 frames
+    double timeBlocks(const Kernels::Variant& variant, size_t blockSize, bool tvBypassed, bool absorptionBypassed)
+    {
+        const size_t numBlocks = jmax((size_t) 1, (256 + blockSize - 1) / blockSize);
+        double best = std::numeric_limits<double>::max();
+        
+        for (int run = 0; run < 3; run++)
+        {
+            auto start = Time::getHighResolutionTicks();
+            
+            for (size_t b = 0; b < numBlocks; b++)
+            {
+                variant.planarToFrames(inputPointers.data(), inFrames.data(), N, blockSize);
+                
+                for (size_t i = 0; i < blockSize; i++)
+                {
+                    delays.popSamples(frame.data());
+                    
+                    if (! absorptionBypassed)
+                        absorption.filt(frame.data(), frame.data());
+                    
+                    if (tvBypassed)
+                        variant.matrixProduct(frame.data(), matrix.data(), mixed.data(), N, N);
+                    else
+                        tv.filt(frame.data(), mixed.data());
+                    
+                    float* output = outFrames.data() + i * N;
+                    const float* input = inFrames.data() + i * N;
+                    for (size_t j = 0; j < N; j++)
+                    {
+                        output[j] = mixed[j];
+                        frame[j] = input[j] + mixed[j];
+                    }
+                    
+                    delays.pushSamples(frame.data());
+                }
+                
+                variant.framesToPlanar(outFrames.data(), outputPointers.data(), N, blockSize);
+            }
+            
+            best = jmin(best, Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - start));
+        }
+        
+        return best / (double) (numBlocks * blockSize);
+    }
+};
+
+class KernelTuneThread : public Thread
+{
+public:
+    
+    KernelTuner& tuner;
+    
+    KernelTuneThread(KernelTuner& _tuner) : Thread("FDN kernel tuning"), tuner(_tuner)
+    {
+    }
+    
+    ~KernelTuneThread() override
+    {
+        stopThread(5000);
+    }
+    
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            tuner.tunePending();
+            wait(5);
+        }
+    }
+};
+
+// The parameters that FDN::scheduleParameter can automate, numbered as in the C API
+enum class AutomationParameter
+{
+    RT_DC = 0,
+    RT_NY,
+    RT_CrossOverFrequency,
+    osc_frequency,
+    delayFactor,
+    spread,
+    TVBypassed,
+    AbsorptionBypassed,
+    MultiBandAbsorption,
+    RT_63Hz,                    // .. RT_8kHz, one per octave band
+    EarlyReflections = RT_63Hz + MultiBandAbsorptionFilters::numBands,
+    SubbandMode,
+    AdaptiveOrder,
+    numParameters
+};
+
+struct AutomationEvent
+{
+    size_t sample;              // from the start of the next process call
+    AutomationParameter parameter;
+    float value;
+};
+
+class FDN
+{
+public:
+    
+    bool TVBypassed{false};
+    bool AbsorptionBypassed{false};
+    
+    float fs{48000.f};
+    size_t N = 64;
+    size_t  MyNumberOfInputs = N;
+    size_t  MyNumberOfOutputs = N;
+    size_t  BufferSize = 1;
+    bool isPrepared{false};
+    
+    // kernel variant and processing block size. Until KernelTuner has timed them for the
+    // current host block size, and always without autotune, the best variant for the CPU
+    // (or the one forced with TVFDN_KERNELS) runs on whole host blocks
+    const Kernels::Variant* kernels = &Kernels::getBaseline();
+    size_t processingBlockSize = 1;
+    size_t tunedBlockSize = 0;          // of the installed tuning, 0 before the first
+    size_t tunedForBlockSize = 0;       // host block size the last tuning was requested for
+    int64_t installedTuning{0};
+    bool autotune{true};
+    
+    // published for the stats getters, readable from any thread
+    std::atomic<const char*> kernelName{Kernels::getBaseline().name};
+    std::atomic<int> blockSizeLevel{0};
+    
+    // hand-over of delay lines in a new format (see setDelayPrecision)
+    enum PrecisionSwitch { precisionIdle, precisionStaged, precisionSwapping };
+    std::atomic<int> precisionSwitch{precisionIdle};
+    CriticalSection precisionLock;      // never taken by the audio thread
+    
+    // host channels actually connected, and those of them carrying signal in the current block
+    size_t numConnectedInputs = N;
+    size_t numConnectedOutputs = N;
+    std::array<int, 64> activeInputs{};
+    size_t numActiveInputs = 0;
+    size_t numActiveOutputs = 0;
+    
+    // frame-major staging of the host I/O: frame i of a block starts at i * N
+    std::vector<float> inFrames;
+    std::vector<float> outFrames;
+    std::vector<float> earlyFrames; // early reflections, added to outFrames after the network
+    std::vector<float> lineFrames;  // delay outputs, as the lines are read, for the watchdog
+    std::vector<float> silence;   // read for inactive inputs
+    std::vector<float> discard;   // written for unconnected outputs
+    std::array<const float*, 64> inputPointers{};
+    std::array<float*, 64> outputPointers{};
+    
+    float RT_DC{1.5f};
+    float RT_NY{0.5f};
+    float RT_CrossOverFrequency{1000.f};
+    float osc_frequency{1.f};
+    float spread{0.5f};
+    float delayFactor{1.f};
+    
+    bool MultiBandAbsorption{false};
+    std::array<float, MultiBandAbsorptionFilters::numBands> RT_Bands = MultiBandAbsorptionFilters::defaultRT;
+    
+    bool EarlyReflections{false};       // only has an effect once an IR is loaded
+    bool earlyReflectionsRunning{false};
+    
+    bool SubbandMode{false};
+    bool subbandRunning{false};
+    
+    // Adaptive Order: the share of the block duration spent in processFrames is measured,
+    // and its peak (released over loadRelease seconds) above reduceAbove crossfades to the
+    // reduced network. It fades back once the load predicted for the full network has stayed
+    // below restoreBelow for restoreHold seconds.
+    bool AdaptiveOrder{false};
+    float reduceAbove{0.7f};
+    float restoreBelow{0.5f};
+    float restoreHold{1.f};
+    float loadRelease{0.5f};
+    float orderFadeTime{0.02f};
+    float loadLevel{0.f};
+    float calmTime{0.f};
+    bool reducedActive{false};          // the reduced network is the one heard, or faded in
+    size_t fadeLength{0};
+    size_t fadePosition{0};             // fading while below fadeLength
+    std::atomic<int> orderLevel{64};    // lines currently heard, for the telemetry
+    
+    // scheduled parameter changes, sorted by sample (see scheduleParameter)
+    static constexpr size_t maxAutomationEvents = 1024;
+    std::array<AutomationEvent, maxAutomationEvents> automationEvents{};
+    size_t numAutomationEvents{0};
+    std::array<int, (size_t) AutomationParameter::numParameters> pendingEvents{};
+
+//    signal frames, scratch of the per-frame loops (64 lines at most, as the channel arrays)
+    alignas(64) std::array<float, 64> delayOutput{};
+    alignas(64) std::array<float, 64> delayInput{};     // input plus feedback, pushed into the lines
+    alignas(64) std::array<float, 64> reducedInput{};
+    alignas(64) std::array<float, 64> reducedOutput{};
+
+    // ###############  FDN parameters ###############
+    
+    ImportedMatrices Matrices;
+    dsp::Matrix<float> DELAYS {N,1,Matrices.delays.getRawDataPointer()};
+    dsp::Matrix<float> Directs{MyNumberOfInputs,MyNumberOfOutputs,Matrices.directs.getRawDataPointer()};
+    dsp::Matrix<float> InGains{MyNumberOfInputs,N,Matrices.inGains.getRawDataPointer()};
+    dsp::Matrix<float> OutGains{N,MyNumberOfOutputs,Matrices.outGains.getRawDataPointer()};
+    dsp::Matrix<float> feedbackMatrix{N,N,Matrices.feedbackMatrixValues.getRawDataPointer()};
+    dsp::Matrix<float> feedbackMatrixTransposed{N,N,Matrices.feedbackMatrixValuesTransposed.getRawDataPointer()};
+    
+    Delays delays;
+    AbsorptionFilters absorptionFilters;
+    MultiBandAbsorptionFilters multiBandAbsorption;
+    TVmatrix tvMatrix;
+    StabilityWatchdog watchdog;
+    EarlyReflectionConvolver earlyReflections;
+    SubbandFDN subband;
+    ReducedFDN reduced;
+    FeedbackMatrixMorph morph;
+    SignalTracer tracer;
+    MultiBandDesignThread designThread;
+    EarlyReflectionThread earlyReflectionThread;
+    EarlyReflectionDesignThread earlyReflectionDesignThread;
+    TraceDumpThread traceDumpThread;
+    MorphDesignThread morphThread;
+    KernelTuner tuner;
+    KernelTuneThread tunerThread;
+   
+    
+    //################### METHODS ##################
+    FDN() : delays(DELAYS) , absorptionFilters(DELAYS) , multiBandAbsorption(DELAYS) , tvMatrix(N) , watchdog(N) , earlyReflections(N) , subband(DELAYS, feedbackMatrixTransposed.getRawDataPointer()) , reduced(DELAYS, feedbackMatrixTransposed.getRawDataPointer()) , morph(N, feedbackMatrixTransposed.getRawDataPointer()) , tracer(N, N/2) , designThread(multiBandAbsorption) , earlyReflectionThread(earlyReflections) , earlyReflectionDesignThread(earlyReflections) , traceDumpThread(tracer) , morphThread(morph) , tuner(DELAYS, feedbackMatrixTransposed.getRawDataPointer(), N) , tunerThread(tuner)
+    {
+        
+    };
+
+    //    ################## PREPARE FUNCTION ##################
+    
+    // Hosts call prepareToPlay repeatedly (transport start, offline bounce, ...).
+    // All memory is sized by the first call; later calls with an unchanged sample
+    // rate return immediately, a new sample rate only recomputes the rate-dependent
+    // state (filter coefficients, oscillator increments) and clears the lines.
+    void prepare(const dsp::ProcessSpec& Spec,const dsp::ProcessSpec& filterSpec  )
+    {
+        BufferSize = jmax((size_t) Spec.maximumBlockSize, (size_t) 1);
+        
+        // only grows the staging buffers, shrinking keeps the memory
+        inFrames.resize(BufferSize * N);
+        outFrames.resize(BufferSize * N);
+        earlyFrames.resize(BufferSize * N);
+        lineFrames.resize(BufferSize * N);
+        silence.resize(BufferSize, 0.f);
+        discard.resize(BufferSize);
+        
+        // a tuning for smaller host blocks stays clamped to the block until the new one arrives
+        processingBlockSize = tunedBlockSize > 0 ? jmin(tunedBlockSize, BufferSize) : BufferSize;
+        blockSizeLevel.store((int) processingBlockSize, std::memory_order_relaxed);
+        
+        if (! autotune)
+        {
+            auto* forced = Kernels::getOverride();
+            selectKernels(forced != nullptr ? *forced : Kernels::getBest());
+        }
+        else if (BufferSize > tunedForBlockSize)
+        {
+            if (tunedBlockSize == 0)
+                selectKernels(Kernels::getBest());
+            
+            tunedForBlockSize = BufferSize;
+            tuner.request(BufferSize, Spec.sampleRate, TVBypassed, AbsorptionBypassed);
+            tunerThread.startThread();
+        }
+        
+        acquireDelayPrecision();
+        
+        if (isPrepared && Spec.sampleRate == fs)
+            return;
+        
+        isPrepared = true;
+        fs = Spec.sampleRate;
+        
+        delays.prepare(Spec);
+        
+        absorptionFilters.prepare(filterSpec);
+        
+        multiBandAbsorption.prepare(filterSpec);
+        
+        tvMatrix.prepare(Spec);
+        
+        subband.prepare(Spec, filterSpec);
+        
+        reduced.prepare(Spec, filterSpec);
+        resetOrder();
+        
+        designThread.startThread();
+        morphThread.startThread();
+        
+        earlyReflectionThread.stopThread(1000);
+        earlyReflections.prepare(Spec);
+        
+        earlyReflections.reset();
+        earlyReflectionThread.startThread();
+        earlyReflectionDesignThread.startThread();
+    }
+    
+    //    ############## EARLY REFLECTIONS ###############
+    
+    // Loads the measured early reflections (one channel per line, or fewer channels
+    // repeated over the lines; an empty buffer unloads them). Copies the IR, so not from
+    // the audio thread, but safe while process() runs: the IR is partitioned on
+    // EarlyReflectionDesignThread and replaces the current one at the start of a later
+    // block, from silence.
+    void setEarlyReflections(const AudioBuffer<float>& ir, double irSampleRate)
+    {
+        earlyReflections.setImpulseResponse(ir, irSampleRate);
+        earlyReflectionDesignThread.notify();
+    }
+    
+    //    ############## KERNEL SELECTION ###############
+    
+    void selectKernels(const Kernels::Variant& variant)
+    {
+        kernels = &variant;
+        delays.kernels = &variant;
+        absorptionFilters.kernels = &variant;
+        multiBandAbsorption.kernels = &variant;
+        earlyReflections.kernels = &variant;
+        tvMatrix.kernels = &variant;
+        watchdog.kernels = &variant;
+        subband.selectKernels(variant);
+        reduced.selectKernels(variant);
+        kernelName.store(variant.name, std::memory_order_relaxed);
+    }
+    
+    //    ############## SIGNAL TRACE ###############
+    
+    // Arms the flight recorder for the given SignalTracer::Signal bits, keeping the last
+    // `seconds` of the full-rate network (Subband Mode is not traced). On a trigger, or
+    // when the watchdog engages, half of that is recorded past the trigger and written
+    // into a new folder in `directory`. Allocates the rings on the calling thread, so not
+    // from the audio thread; process picks them up with its next block.
+    void enableTracing(int signals, double seconds, const File& directory)
+    {
+        tracer.enable(signals, (size_t) (seconds * fs), directory, fs);
+        traceDumpThread.startThread();
+    }
+    
+    // any thread
+    void disableTracing()
+    {
+        tracer.disable();
+    }
+    
+    // any thread
+    void triggerTrace()
+    {
+        tracer.trigger();
+    }
+    
+    //    ############## DELAY PRECISION ###############
+    
+    // Storage format of all delay lines, float32 by default. The lines are allocated on
+    // the calling thread and swapped in at the start of the next block, which clears the
+    // tail. Any thread but the audio thread; waits up to 0.2 s for that block to free the
+    // old lines, otherwise prepare or the next block swaps and the next call frees them.
+    void setDelayPrecision(Delays::Precision precision)
+    {
+        const ScopedLock sl(precisionLock);
+        
+        // take back lines the audio thread has not picked up yet; a swap in progress is O(1)
+        for (;;)
+        {
+            int state = precisionSwitch.load(std::memory_order_acquire);
+            if (state == precisionIdle)
+                break;
+            if (state == precisionStaged && precisionSwitch.compare_exchange_strong(state, precisionIdle, std::memory_order_acquire))
+                break;
+            Thread::yield();
+        }
+        
+        delays.stagePrecision(precision);
+        subband.stageDelayPrecision(precision);
+        reduced.stageDelayPrecision(precision);
+        precisionSwitch.store(precisionStaged, std::memory_order_release);
+        
+        // before the first prepare, that prepare swaps them
+        for (int i = 0; i < 200 && isPrepared && precisionSwitch.load(std::memory_order_acquire) != precisionIdle; ++i)
+            Thread::sleep(1);
+        
+        if (precisionSwitch.load(std::memory_order_acquire) == precisionIdle)
+        {
+            delays.releaseStaged();
+            subband.releaseStagedDelays();
+            reduced.releaseStagedDelays();
+        }
+    }
+    
+    // audio thread, at the start of a block (and prepare): switches to staged lines
+    void acquireDelayPrecision()
+    {
+        int staged = precisionStaged;
+        if (precisionSwitch.load(std::memory_order_relaxed) == staged
+            && precisionSwitch.compare_exchange_strong(staged, precisionSwapping, std::memory_order_acquire))
+        {
+            delays.swapStaged();
+            subband.swapStagedDelays();
+            reduced.swapStagedDelays();
+            resetOrder();
+            precisionSwitch.store(precisionIdle, std::memory_order_release);
+        }
+    }
+    
+    // audio thread, at the start of a block: switches to the result of the last tuning
+    void installTuning()
+    {
+        const int64_t tuning = tuner.result.load(std::memory_order_acquire);
+        
+        if (tuning == installedTuning)
+            return;
+        
+        installedTuning = tuning;
+        selectKernels(KernelTuner::unpackVariant(tuning));
+        tunedBlockSize = KernelTuner::unpackBlockSize(tuning);
+        processingBlockSize = jmin(tunedBlockSize, BufferSize);
+        blockSizeLevel.store((int) processingBlockSize, std::memory_order_relaxed);
+    }
+    
+
+    //    ############## ACTIVE CHANNELS ###############
+    
+    void setNumChannels(size_t _numInputs, size_t _numOutputs)
+    {
+        numConnectedInputs = jmin(_numInputs, MyNumberOfInputs);
+        numConnectedOutputs = jmin(_numOutputs, MyNumberOfOutputs);
+    }
+    
+    // Connected inputs that are silent for the whole block are skipped, as are
+    // outputs the host does not provide. The network itself always runs at full order.
+    void updateActiveChannels(const dsp::AudioBlock<float>& block)
+    {
+        size_t numChannels = block.getNumChannels();
+        
+        numActiveInputs = 0;
+        for (size_t IN = 0; IN < jmin(numConnectedInputs, numChannels); ++IN)
+        {
+            auto range = block.getSingleChannelBlock(IN).findMinAndMax();
+            if (range.getStart() != 0.f || range.getEnd() != 0.f)
+            {
+                activeInputs[numActiveInputs++] = (int) IN;
+            }
+        }
+        
+        numActiveOutputs = jmin(numConnectedOutputs, numChannels);
+    }
+    
+    // the host cost of the I/O is paid once per block, with SIMD transposes
+    void stageInputs(const dsp::AudioBlock<float>& block)
+    {
+        inputPointers.fill(silence.data());
+        
+        for (size_t k = 0; k < numActiveInputs; ++k)
+        {
+            inputPointers[activeInputs[k]] = block.getChannelPointer(activeInputs[k]);
+        }
+        
+        kernels->planarToFrames(inputPointers.data(), inFrames.data(), N, block.getNumSamples());
+    }
+    
+    void stageOutputs(const dsp::AudioBlock<float>& block)
+    {
+        for (size_t OUT = 0; OUT < N; ++OUT)
+        {
+            outputPointers[OUT] = OUT < numActiveOutputs ? block.getChannelPointer(OUT) : discard.data();
+        }
+        
+        kernels->framesToPlanar(outFrames.data(), outputPointers.data(), N, block.getNumSamples());
+    }
+    
+    //    ################# AUTOMATION ###################
+    
+    // Schedules `parameter` to reach `value` at `sample`, counted from the start of the
+    // next process call; later calls count on from there. The RTs, the crossover and the
+    // oscillator frequency and spread ramp linearly to the value, from their previous
+    // point or from the start of the next process call; the other parameters switch at
+    // that sample. A point only splits the processingBlockSize chunk it falls into, and
+    // the watchdog still judges the whole host block. Audio thread, between process
+    // calls; returns false when the queue is full.
+    bool scheduleParameter(AutomationParameter parameter, float value, size_t sample)
+    {
+        if (numAutomationEvents == maxAutomationEvents)
+            return false;
+        
+        // after the points at the same sample, so that they apply in the order given
+        size_t position = numAutomationEvents;
+        while (position > 0 && automationEvents[position - 1].sample > sample)
+        {
+            automationEvents[position] = automationEvents[position - 1];
+            position--;
+        }
+        
+        automationEvents[position] = { sample, parameter, value };
+        numAutomationEvents++;
+        pendingEvents[(size_t) parameter]++;
+        return true;
+    }
+    
+    bool hasPendingEvents(AutomationParameter parameter) const
+    {
+        return pendingEvents[(size_t) parameter] > 0;
+    }
+    
+    // the parameters that ramp towards their points, the others switch
+    static bool isRamped(AutomationParameter parameter)
+    {
+        return parameter == AutomationParameter::RT_DC || parameter == AutomationParameter::RT_NY || parameter == AutomationParameter::RT_CrossOverFrequency
+            || parameter == AutomationParameter::osc_frequency || parameter == AutomationParameter::spread;
+    }
+    
+    void setParameter(AutomationParameter parameter, float value)
+    {
+        const bool on = value >= 0.5f;
+        
+        switch (parameter)
+        {
+            case AutomationParameter::RT_DC:                    RT_DC = value; break;
+            case AutomationParameter::RT_NY:                    RT_NY = value; break;
+            case AutomationParameter::RT_CrossOverFrequency:    RT_CrossOverFrequency = value; break;
+            case AutomationParameter::osc_frequency:            osc_frequency = value; break;
+            case AutomationParameter::delayFactor:              delayFactor = value; break;
+            case AutomationParameter::spread:                   spread = value; break;
+            case AutomationParameter::TVBypassed:               TVBypassed = on; break;
+            case AutomationParameter::AbsorptionBypassed:       AbsorptionBypassed = on; break;
+            case AutomationParameter::MultiBandAbsorption:      MultiBandAbsorption = on; break;
+            case AutomationParameter::EarlyReflections:         EarlyReflections = on; break;
+            case AutomationParameter::SubbandMode:              SubbandMode = on; break;
+            case AutomationParameter::AdaptiveOrder:            AdaptiveOrder = on; break;
+            case AutomationParameter::numParameters:            break;
+            default:
+                RT_Bands[(size_t) parameter - (size_t) AutomationParameter::RT_63Hz] = value;
+                break;
+        }
+    }
+    
+    // Sets the ramped parameters to their value at `end` on the line towards their next
+    // point, and hands the slope to the filters and oscillators as per-sample ramps
+    // over the segment. The cursors only move forward within a block.
+    void rampParameters(size_t start, size_t end, size_t next, std::array<size_t, 5>& cursors)
+    {
+        static constexpr AutomationParameter ramped[] { AutomationParameter::RT_DC, AutomationParameter::RT_NY, AutomationParameter::RT_CrossOverFrequency,
+                                                        AutomationParameter::osc_frequency, AutomationParameter::spread };
+        float* const fields[] { &RT_DC, &RT_NY, &RT_CrossOverFrequency, &osc_frequency, &spread };
+        bool rampAbsorption = false, rampOscillators = false;
+        
+        for (size_t r = 0; r < 5; r++)
+        {
+            if (! hasPendingEvents(ramped[r]))
+                continue;
+            
+            size_t& k = cursors[r];
+            k = jmax(k, next);
+            while (k < numAutomationEvents && automationEvents[k].parameter != ramped[r])
+                k++;
+            
+            if (k == numAutomationEvents)
+                continue;
+            
+            auto& point = automationEvents[k];
+            float& field = *fields[r];
+            field = end == point.sample ? point.value : field + (point.value - field) * (float) (end - start) / (float) (point.sample - start);
+            
+            (r < 3 ? rampAbsorption : rampOscillators) = true;
+        }
+        
+        if (rampAbsorption)
+            absorptionFilters.rampFirstOrderFilter(RT_DC, RT_NY, RT_CrossOverFrequency, delayFactor, end - start);
+        
+        if (rampOscillators)
+            tvMatrix.rampOscFrequency(osc_frequency, spread, end - start);
+    }
+    
+    void processAutomated(dsp::AudioBlock<float> block)
+    {
+        const size_t numSamples = block.getNumSamples();
+        std::array<size_t, 5> cursors{};
+        size_t next = 0;    // first point not reached yet
+        
+        for (size_t start = 0; start < numSamples; )
+        {
+            // the points due now: switches flip, ramps land exactly on their value
+            while (next < numAutomationEvents && automationEvents[next].sample <= start)
+            {
+                auto& point = automationEvents[next++];
+                setParameter(point.parameter, point.value);
+                pendingEvents[(size_t) point.parameter]--;
+            }
+            
+            // on the processingBlockSize grid of the block, so that a point only splits the
+            // chunk it falls into and the following chunks are whole again
+            size_t end = jmin(numSamples, (start / processingBlockSize + 1) * processingBlockSize);
+            if (next < numAutomationEvents)
+                end = jmin(end, automationEvents[next].sample);
+            
+            rampParameters(start, end, next, cursors);
+            processFrames(block.getSubBlock(start, end - start));
+            start = end;
+        }
+        
+        // the rest moves on to the next call
+        for (size_t k = next; k < numAutomationEvents; k++)
+        {
+            automationEvents[k - next] = automationEvents[k];
+            automationEvents[k - next].sample -= numSamples;
+        }
+        numAutomationEvents -= next;
+    }
+    
+    //    ################# PROCESS FUNCTION ###################
+    
+    void process(dsp::AudioBlock<float> block)
+    {
+        if (autotune)
+            installTuning();
+        
+        acquireDelayPrecision();
+        
+        const bool wasEngaged = watchdog.isEngaged();
+        watchdog.beginBlock(block.getNumSamples());
+        
+        if (numAutomationEvents > 0)
+        {
+            processAutomated(block);
+        }
+        else
+        {
+            // hosts may send more samples than announced in prepare; the staging holds BufferSize frames
+            for (size_t start = 0; start < block.getNumSamples(); start += processingBlockSize)
+            {
+                processFrames(block.getSubBlock(start, jmin(processingBlockSize, block.getNumSamples() - start)));
+            }
+        }
+        
+        endWatchdogBlock(block.getNumSamples(), wasEngaged);
+    }
+    
+    // the watchdog judges whole host blocks, however process split them
+    void endWatchdogBlock(size_t numSamples, bool wasEngaged)
+    {
+        watchdog.endBlock(numSamples);
+        
+        if (tracer.triggerOnWatchdog && (watchdog.resetRequested || (! wasEngaged && watchdog.isEngaged())))
+        {
+            tracer.trigger();
+        }
+        
+        if (watchdog.resetRequested)
+        {
+            watchdog.resetRequested = false;
+            delays.reset();
+            absorptionFilters.reset();
+            multiBandAbsorption.reset();
+            subband.reset();
+            reduced.reset();
+            resetOrder();
+        }
+    }
+    
+    void processFrames(dsp::AudioBlock<float> block)
+    {
+        const auto startTicks = AdaptiveOrder || isOrderReduced() ? Time::getHighResolutionTicks() : 0;
+
+        updateActiveChannels(block);
+        stageInputs(block);
+
+        delays.updateDelayFactor(delayFactor);
+        
+        tvMatrix.updateOscFrequency(osc_frequency,spread);
+        
+        absorptionFilters.updateFirstOrderFilter(RT_DC,RT_NY,RT_CrossOverFrequency,delayFactor);
+        
+        multiBandAbsorption.requestDesign(RT_Bands, delayFactor);
+        multiBandAbsorption.acquireCoefficients();
+        
+        morph.beginBlock(block.getNumSamples(), fs);
+        
+        if (AdaptiveOrder || isOrderReduced())
+        {
+            reduced.update(RT_DC, RT_NY, RT_CrossOverFrequency, osc_frequency, spread, delayFactor);
+        }
+        
+        // the network that takes over starts from silence
+        if (SubbandMode)
+        {
+            subband.update(RT_DC, RT_NY, RT_CrossOverFrequency, osc_frequency, spread, delayFactor);
+        }
+        if (SubbandMode != subbandRunning)
+        {
+            if (SubbandMode)
+            {
+                subband.reset();
+                resetOrder();
+            }
+            else
+            {
+                delays.reset();
+                absorptionFilters.reset();
+                multiBandAbsorption.reset();
+            }
+            subbandRunning = SubbandMode;
+        }
+        
+        earlyReflections.acquirePartitions();
+        
+        bool early = EarlyReflections && earlyReflections.isLoaded();
+        if (early && ! earlyReflectionsRunning)
+        {
+            earlyReflections.restart();
+        }
+        earlyReflectionsRunning = early;
+        earlyReflections.setTailDelay(SubbandMode ? subband.shortestDelay() : delays.shortestDelay());
+        
+        const bool applyGain = watchdog.isEngaged();
+        const float gain = watchdog.gain;
+        const float gainStep = watchdog.gainStep;
+        
+        // PROCESS
+        const size_t numFrames = block.getNumSamples();
+        
+        if (SubbandMode)
+            processSubbandFrames(numFrames, early, applyGain, gain, gainStep);
+        else if (isOrderReduced())
+            processReducedFrames(numFrames, early, applyGain, gain, gainStep);
+        else if (tracer.beginBlock())
+            runNetworkFrames<true>(numFrames, early, applyGain, gain, gainStep);
+        else
+            runNetworkFrames<false>(numFrames, early, applyGain, gain, gainStep);
+        
+        watchdog.accumulate(lineFrames.data(), numFrames);
+        watchdog.gain += gainStep * (float) numFrames;
+        
+        if (early)
+        {
+            FloatVectorOperations::add(outFrames.data(), earlyFrames.data(), (int) (numFrames * N));
+        }
+        
+        stageOutputs(block);
+        
+        if (morph.finished())
+        {
+            installMorphTarget();
+        }
+        
+        if (startTicks != 0)
+        {
+            updateOrder(Time::highResolutionTicksToSeconds(Time::getHighResolutionTicks() - startTicks), numFrames);
+        }
+    }
+    
+    //    ############## MATRIX MORPH ###############
+    
+    // Glides the static feedback matrix (the one used with TV Bypassed) to target, an
+    // orthogonal N x N matrix in row-major order, over seconds, staying orthogonal on the
+    // way (see FeedbackMatrixMorph). Returns false if target is not orthogonal. The path
+    // is designed on a background thread and starts with the next block after that. The
+    // reduced and the subband networks switch to the target when the morph ends. Call it
+    // from any thread but the audio thread.
+    bool morphFeedbackMatrix(const float* target, double seconds)
+    {
+        return morph.request(target, seconds);
+    }
+    
+    // O(N^2) once per morph: copies, the reduced matrix has its size already
+    void installMorphTarget()
+    {
+        std::copy(morph.targetTransposed.begin(), morph.targetTransposed.end(), feedbackMatrixTransposed.getRawDataPointer());
+        std::copy(morph.targetMatrix.begin(), morph.targetMatrix.end(), feedbackMatrix.getRawDataPointer());
+        std::copy(morph.reducedTarget.begin(), morph.reducedTarget.end(), reduced.matrix.begin());
+        morph.finish();
+    }
+    
+    //    ############## ADAPTIVE ORDER ###############
+    
+    // the reduced network is heard, or fading in or out
+    bool isOrderReduced() const
+    {
+        return reducedActive || fadePosition < fadeLength;
+    }
+    
+    void updateOrder(double seconds, size_t numFrames)
+    {
+        const float blockTime = (float) numFrames / fs;
+        
+        // the blocks that run both networks say nothing about either
+        if (fadePosition < fadeLength)
+            return;
+        
+        loadLevel = jmax((float) seconds / blockTime, loadLevel * std::exp(-blockTime / loadRelease));
+        
+        if (! reducedActive)
+        {
+            if (AdaptiveOrder && ! SubbandMode && loadLevel > reduceAbove)
+                startOrderFade(true);
+            return;
+        }
+        
+        const float predictedLoad = loadLevel * (float) (N / ReducedFDN::M);
+        calmTime = predictedLoad < restoreBelow ? calmTime + blockTime : 0.f;
+        
+        if (! AdaptiveOrder || calmTime >= restoreHold)
+            startOrderFade(false);
+    }
+    
+    // the network faded in continues from the state of the other
+    void startOrderFade(bool toReduced)
+    {
+        if (toReduced)
+        {
+            reduced.takeOver(delays);
+        }
+        else
+        {
+            reduced.handBack(delays);
+            absorptionFilters.reset();
+            multiBandAbsorption.reset();
+        }
+        
+        reducedActive = toReduced;
+        fadeLength = jmax((size_t) 1, (size_t) (orderFadeTime * fs));
+        fadePosition = 0;
+        loadLevel = 0.f;
+        calmTime = 0.f;
+        orderLevel.store((int) (toReduced ? ReducedFDN::M : N), std::memory_order_relaxed);
+    }
+    
+    // back to the full network at once, its lines are cleared by the caller
+    void resetOrder()
+    {
+        reducedActive = false;
+        fadeLength = 0;
+        fadePosition = 0;
+        loadLevel = 0.f;
+        calmTime = 0.f;
+        orderLevel.store((int) N, std::memory_order_relaxed);
+    }
+    
+    template <bool traced>
+    void runNetworkFrames(size_t numFrames, bool early, bool applyGain, float gain, float gainStep)
+    {
+        if (TVBypassed)
+            AbsorptionBypassed ? processNetworkFrames<true, true, traced>(numFrames, early, applyGain, gain, gainStep)
+                               : processNetworkFrames<true, false, traced>(numFrames, early, applyGain, gain, gainStep);
+        else
+            AbsorptionBypassed ? processNetworkFrames<false, true, traced>(numFrames, early, applyGain, gain, gainStep)
+                               : processNetworkFrames<false, false, traced>(numFrames, early, applyGain, gain, gainStep);
+    }
+    
+    // The full-rate network, one pass per frame from inFrames to outFrames: pop, absorb,
+    // mix, push. The frame stays in delayOutput/delayInput (L1) between the stages, the
+    // mixed frame is written straight into outFrames, the popped one into lineFrames. The switches are template
+    // parameters, so only the stages that run are in the loop, and the tracer only
+    // costs anything while it records.
+    template <bool tvBypassed, bool absorptionBypassed, bool traced>
+    void processNetworkFrames(size_t numFrames, bool early, bool applyGain, float gain, float gainStep)
+    {
+        const bool multiBand = MultiBandAbsorption;
+        
+        for (size_t i = 0; i < numFrames; i++)
+        {
+            const float* input = inFrames.data() + i * N;
+            float* output = outFrames.data() + i * N;
+            float* lines = lineFrames.data() + i * N;
+            
+            if (early)
+            {
+                earlyReflections.processFrame(input, earlyFrames.data() + i * N, delayInput.data());
+                input = delayInput.data();
+            }
+            
+            if (applyGain)
+                gain += gainStep;
+            
+            networkFrame<tvBypassed, absorptionBypassed, traced>(input, output, lines, multiBand, applyGain, gain);
+        }
+    }
+    
+    template <bool tvBypassed, bool absorptionBypassed, bool traced>
+    forcedinline void networkFrame(const float* input, float* output, float* lines, bool multiBand, bool applyGain, float gain)
+    {
+        delays.popSamples(delayOutput.data());
+        std::copy_n(delayOutput.data(), N, lines);
+        
+        if constexpr (traced)
+            tracer.record(SignalTracer::delayOutputs, delayOutput.data());
+        
+        if constexpr (! absorptionBypassed)
+        {
+            if (multiBand)
+                multiBandAbsorption.filt(delayOutput.data());
+            else
+                absorptionFilters.filt(delayOutput.data(), delayOutput.data());
+        }
+        
+        if constexpr (tvBypassed)
+        {
+            if (morph.active)
+                morph.apply(delayOutput.data(), output, *kernels);
+            else
+                kernels->matrixProduct(delayOutput.data(), feedbackMatrixTransposed.getRawDataPointer(), output, N, N);
+        }
+        else
+            tvMatrix.filt(delayOutput.data(), output);
+        
+        if constexpr (traced)
+        {
+            tracer.record(SignalTracer::postAbsorption, delayOutput.data());
+            tracer.record(SignalTracer::postMixing, output);
+            tracer.recordOscillators(tvMatrix.cosines.data(), tvMatrix.sines.data());
+            tracer.endFrame();
+        }
+        
+        if (applyGain)
+            FloatVectorOperations::multiply(output, gain, (int) N);
+        
+        // input may be delayInput itself, element by element that is fine
+        for (size_t j = 0; j < N; j++)
+            delayInput[j] = input[j] + output[j];
+        
+        delays.pushSamples(delayInput.data());
+    }
+    
+    // switches at run time, for the frames the full network runs next to the reduced one
+    void runNetworkFrame(const float* input, float* output, float* lines, bool multiBand, bool applyGain, float gain)
+    {
+        if (TVBypassed)
+            AbsorptionBypassed ? networkFrame<true, true, false>(input, output, lines, multiBand, applyGain, gain)
+                               : networkFrame<true, false, false>(input, output, lines, multiBand, applyGain, gain);
+        else
+            AbsorptionBypassed ? networkFrame<false, true, false>(input, output, lines, multiBand, applyGain, gain)
+                               : networkFrame<false, false, false>(input, output, lines, multiBand, applyGain, gain);
+    }
+    
+    // The reduced network, and the crossfade between the two while the order changes:
+    // both run on the same input and the output fades linearly from one to the other.
+    // The tracer pauses meanwhile, and the watchdog sees the lines of the full network.
+    void processReducedFrames(size_t numFrames, bool early, bool applyGain, float gain, float gainStep)
+    {
+        const bool multiBand = MultiBandAbsorption;
+        
+        for (size_t i = 0; i < numFrames; i++)
+        {
+            const float* input = inFrames.data() + i * N;
+            float* output = outFrames.data() + i * N;
+            float* lines = lineFrames.data() + i * N;
+            
+            if (early)
+            {
+                earlyReflections.processFrame(input, earlyFrames.data() + i * N, delayInput.data());
+                input = delayInput.data();
+            }
+            
+            if (applyGain)
+                gain += gainStep;
+            
+            if (fadePosition < fadeLength)
+            {
+                // networkFrame overwrites delayInput, which may hold the input
+                std::copy(input, input + N, reducedInput.begin());
+                reduced.processFrame(reducedInput.data(), reducedOutput.data(), lines, applyGain, gain, TVBypassed, AbsorptionBypassed);
+                runNetworkFrame(reducedInput.data(), output, lines, multiBand, applyGain, gain);
+                
+                float position = (float) (++fadePosition) / (float) fadeLength;
+                float weight = reducedActive ? position : 1.f - position;   // of the reduced network
+                
+                for (size_t j = 0; j < N; j++)
+                    output[j] += weight * (reducedOutput[j] - output[j]);
+            }
+            else if (reducedActive)
+            {
+                reduced.processFrame(input, output, lines, applyGain, gain, TVBypassed, AbsorptionBypassed);
+            }
+            else
+            {
+                runNetworkFrame(input, output, lines, multiBand, applyGain, gain);
+            }
+        }
+    }
+    
+    void processSubbandFrames(size_t numFrames, bool early, bool applyGain, float gain, float gainStep)
+    {
+        for (size_t i = 0; i < numFrames; i++)
+        {
+            const float* input = inFrames.data() + i * N;
+            float* output = outFrames.data() + i * N;
+            float* lines = lineFrames.data() + i * N;
+            
+            if (early)
+            {
+                earlyReflections.processFrame(input, earlyFrames.data() + i * N, delayInput.data());
+                input = delayInput.data();
+            }
+            
+            if (applyGain)
+                gain += gainStep;
+            
+            subband.processFrame(input, output, lines, applyGain ? gain : 1.f, TVBypassed, AbsorptionBypassed);
+        }
+    }
+};
+
+
+// The user parameters of an FDN, to hand them between threads in one piece
+struct FDNParameters
+{
+    float RT_DC{1.5f};
+    float RT_NY{0.5f};
+    float RT_CrossOverFrequency{1000.f};
+    float osc_frequency{1.f};
+    float spread{0.5f};
+    float delayFactor{1.f};
+    bool TVBypassed{false};
+    bool AbsorptionBypassed{false};
+    bool MultiBandAbsorption{false};
+    std::array<float, MultiBandAbsorptionFilters::numBands> RT_Bands = MultiBandAbsorptionFilters::defaultRT;
+    bool EarlyReflections{false};
+    bool SubbandMode{false};
+    bool AdaptiveOrder{false};
+    
+    // one value, numbered as for FDN::scheduleParameter; the switches as 0 or 1
+    float get(AutomationParameter parameter) const
+    {
+        switch (parameter)
+        {
+            case AutomationParameter::RT_DC:                    return RT_DC;
+            case AutomationParameter::RT_NY:                    return RT_NY;
+            case AutomationParameter::RT_CrossOverFrequency:    return RT_CrossOverFrequency;
+            case AutomationParameter::osc_frequency:            return osc_frequency;
+            case AutomationParameter::delayFactor:              return delayFactor;
+            case AutomationParameter::spread:                   return spread;
+            case AutomationParameter::TVBypassed:               return TVBypassed ? 1.f : 0.f;
+            case AutomationParameter::AbsorptionBypassed:       return AbsorptionBypassed ? 1.f : 0.f;
+            case AutomationParameter::MultiBandAbsorption:      return MultiBandAbsorption ? 1.f : 0.f;
+            case AutomationParameter::EarlyReflections:         return EarlyReflections ? 1.f : 0.f;
+            case AutomationParameter::SubbandMode:              return SubbandMode ? 1.f : 0.f;
+            case AutomationParameter::AdaptiveOrder:            return AdaptiveOrder ? 1.f : 0.f;
+            case AutomationParameter::numParameters:            return 0.f;
+            default:
+                return RT_Bands[(size_t) parameter - (size_t) AutomationParameter::RT_63Hz];
+        }
+    }
+    
+    void applyTo(FDN& fdn) const
+    {
+        fdn.RT_DC = RT_DC;
+        fdn.RT_NY = RT_NY;
+        fdn.RT_CrossOverFrequency = RT_CrossOverFrequency;
+        fdn.osc_frequency = osc_frequency;
+        fdn.spread = spread;
+        fdn.delayFactor = delayFactor;
+        fdn.TVBypassed = TVBypassed;
+        fdn.AbsorptionBypassed = AbsorptionBypassed;
+        fdn.MultiBandAbsorption = MultiBandAbsorption;
+        fdn.RT_Bands = RT_Bands;
+        fdn.EarlyReflections = EarlyReflections;
+        fdn.SubbandMode = SubbandMode;
+        fdn.AdaptiveOrder = AdaptiveOrder;
+    }
+};
+
+
+// Runs an FDN on its own real-time thread in fixed blocks of internalBlockSize, for hosts
+// that call with tiny or irregular blocks. The host callback only copies audio into and
+// out of lock-free FIFOs; the output is delayed by getLatencySamples(). A block that is
+// not ready in time is output as silence and counted in numUnderruns.
+// prepare and the other setup methods run on the message thread, process and
+// setParameters on the audio thread.
+class AsyncFDN : public Thread
+{
+public:
+    
+    FDN& fdn;
+    size_t N = 64;
+    
+    size_t internalBlockSize = 512;
+    size_t hostBlockSize = 512;
+    size_t numInputs = 64;
+    size_t numOutputs = 64;
+    double fs{48000.};
+    bool isPrepared{false};
+    
+    // planar rings of N channels, the audio thread writes input and reads output
+    AbstractFifo inputFifo{1};
+    AbstractFifo outputFifo{1};
+    AudioBuffer<float> inputRing;
+    AudioBuffer<float> outputRing;
+    AudioBuffer<float> work;
+    WaitableEvent inputReady;
+    
+    std::atomic<int> numUnderruns{0};
+    std::atomic<int> numOverflows{0};
+    
+    // audio thread: samples the pipeline holds beyond the latency. An underrun outputs
+    // zeros in place of samples still to come (+), an overflow drops input (-). Surplus
+    // output is discarded and missing input is made up with zeros as soon as the FIFOs
+    // allow, so the latency returns to getLatencySamples after every xrun.
+    int drift = 0;
+    
+    // latest parameters from the audio thread, triple-buffered: the writer fills its own
+    // slot and swaps it with the middle one, the reader swaps the middle one in if it is new
+    static constexpr int freshSlot = 4;
+    std::array<FDNParameters, 3> parameterSlots;
+    int writeSlot = 0;
+    std::atomic<int> middleSlot{1};
+    int readSlot = 2;
+    
+    AsyncFDN(FDN& _fdn) : Thread("FDN processing"), fdn(_fdn)
+    {
+        N = fdn.N;
+    }
+    
+    ~AsyncFDN() override
+    {
+        stopThread(1000);
+    }
+    
+    // one internal block to fill, then up to one block duration to process it (or a
+    // whole host block, if that is longer) before its first sample is due
+    int getLatencySamples() const
+    {
+        return getLatencySamples(internalBlockSize, hostBlockSize);
+    }
+    
+    static int getLatencySamples(size_t internalBlockSize, size_t hostBlockSize)
+    {
+        return (int) (internalBlockSize + jmax(internalBlockSize, hostBlockSize));
+    }
+    
+    //############ setup, message thread ###################
+    
+    void prepare(const dsp::ProcessSpec& Spec, const dsp::ProcessSpec& filterSpec, size_t _internalBlockSize, size_t _numInputs, size_t _numOutputs)
+    {
+        stopThread(1000);
+        
+        fs = Spec.sampleRate;
+        internalBlockSize = jmax(_internalBlockSize, (size_t) 1);
+        hostBlockSize = jmax((size_t) Spec.maximumBlockSize, (size_t) 1);
+        numInputs = jmin(_numInputs, N);
+        numOutputs = jmin(_numOutputs, N);
+        
+        dsp::ProcessSpec internalSpec = Spec;
+        internalSpec.maximumBlockSize = (uint32) internalBlockSize;
+        dsp::ProcessSpec internalFilterSpec = filterSpec;
+        internalFilterSpec.maximumBlockSize = (uint32) internalBlockSize;
+        
+        fdn.prepare(internalSpec, internalFilterSpec);
+        fdn.setNumChannels(numInputs, numOutputs);
+        
+        // room for the latency, one internal block in flight and one host block
+        int capacity = getLatencySamples() + (int) (internalBlockSize + hostBlockSize) + 1;
+        inputRing.setSize((int) N, capacity);
+        outputRing.setSize((int) N, capacity);
+        work.setSize((int) N, (int) internalBlockSize);
+        inputRing.clear();
+        outputRing.clear();
+        inputFifo.setTotalSize(capacity);
+        outputFifo.setTotalSize(capacity);
+        
+        // the latency is silence that is already in the output
+        outputFifo.finishedWrite(getLatencySamples());
+        numUnderruns.store(0, std::memory_order_relaxed);
+        numOverflows.store(0, std::memory_order_relaxed);
+        drift = 0;
+        
+        isPrepared = true;
+        start();
+    }
+    
+    void start()
+    {
+        if (isPrepared)
+        {
+            // without the rights for real-time scheduling, the highest normal priority
+            if (! startRealtimeThread(RealtimeOptions{}.withPriority(8).withApproximateAudioProcessingTime((int) internalBlockSize, fs)))
+                startThread(Priority::highest);
+        }
+    }
+    
+    // stops the thread, e.g. to change the FDN setup; start() continues with the FIFOs as they were
+    void stop()
+    {
+        stopThread(1000);
+    }
+    
+    //############ audio thread ###################
+    
+    void setParameters(const FDNParameters& parameters)
+    {
+        parameterSlots[(size_t) writeSlot] = parameters;
+        writeSlot = middleSlot.exchange(writeSlot | freshSlot, std::memory_order_acq_rel) & ~freshSlot;
+    }
+    
+    void process(const dsp::AudioBlock<float>& block)
+    {
+        const int numSamples = (int) block.getNumSamples();
+        int start1, size1, start2, size2;
+        
+        // input dropped earlier: zeros where it was missing, before this block's samples
+        if (drift < 0)
+        {
+            int padding = jmin(-drift, inputFifo.getFreeSpace());
+            inputFifo.prepareToWrite(padding, start1, size1, start2, size2);
+            
+            for (size_t ch = 0; ch < numInputs; ch++)
+            {
+                if (size1 > 0) FloatVectorOperations::clear(inputRing.getWritePointer((int) ch, start1), size1);
+                if (size2 > 0) FloatVectorOperations::clear(inputRing.getWritePointer((int) ch, start2), size2);
+            }
+            
+            inputFifo.finishedWrite(size1 + size2);
+            drift += size1 + size2;
+        }
+        
+        // input: if the DSP thread has fallen this far behind, the newest samples are dropped
+        inputFifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+        
+        for (size_t ch = 0; ch < numInputs; ch++)
+        {
+            const float* in = block.getChannelPointer(ch);
+            if (size1 > 0) FloatVectorOperations::copy(inputRing.getWritePointer((int) ch, start1), in, size1);
+            if (size2 > 0) FloatVectorOperations::copy(inputRing.getWritePointer((int) ch, start2), in + size1, size2);
+        }
+        
+        inputFifo.finishedWrite(size1 + size2);
+        inputReady.signal();
+        
+        if (size1 + size2 < numSamples)
+        {
+            drift -= numSamples - size1 - size2;
+            numOverflows.fetch_add(1, std::memory_order_relaxed);
+        }
+        
+        // output owed from an underrun: the oldest samples are late by that much, skip them
+        // as far as this block can still be filled
+        if (drift > 0)
+        {
+            int surplus = jmin(drift, outputFifo.getNumReady() - numSamples);
+            
+            if (surplus > 0)
+            {
+                outputFifo.prepareToRead(surplus, start1, size1, start2, size2);
+                outputFifo.finishedRead(size1 + size2);
+                drift -= size1 + size2;
+            }
+        }
+        
+        outputFifo.prepareToRead(numSamples, start1, size1, start2, size2);
+        
+        for (size_t ch = 0; ch < block.getNumChannels(); ch++)
+        {
+            float* out = block.getChannelPointer(ch);
+            
+            if (ch < numOutputs)
+            {
+                if (size1 > 0) FloatVectorOperations::copy(out, outputRing.getReadPointer((int) ch, start1), size1);
+                if (size2 > 0) FloatVectorOperations::copy(out + size1, outputRing.getReadPointer((int) ch, start2), size2);
+                FloatVectorOperations::clear(out + size1 + size2, numSamples - size1 - size2);
+            }
+            else
+            {
+                FloatVectorOperations::clear(out, numSamples);
+            }
+        }
+        
+        outputFifo.finishedRead(size1 + size2);
+        
+        if (size1 + size2 < numSamples)
+        {
+            drift += numSamples - size1 - size2;
+            numUnderruns.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    
+    //############ DSP thread ###################
+    
+    void run() override
+    {
+        const int blockSize = (int) internalBlockSize;
+        
+        while (! threadShouldExit())
+        {
+            if (inputFifo.getNumReady() < blockSize || outputFifo.getFreeSpace() < blockSize)
+            {
+                inputReady.wait(10);
+                continue;
+            }
+            
+            ScopedNoDenormals noDenormals;
+            
+            int start1, size1, start2, size2;
+            inputFifo.prepareToRead(blockSize, start1, size1, start2, size2);
+            for (int ch = 0; ch < (int) N; ch++)
+            {
+                work.copyFrom(ch, 0, inputRing, ch, start1, size1);
+                if (size2 > 0) work.copyFrom(ch, size1, inputRing, ch, start2, size2);
+            }
+            inputFifo.finishedRead(blockSize);
+            
+            if ((middleSlot.load(std::memory_order_relaxed) & freshSlot) != 0)
+            {
+                readSlot = middleSlot.exchange(readSlot, std::memory_order_acq_rel) & ~freshSlot;
+                parameterSlots[(size_t) readSlot].applyTo(fdn);
+            }
+            
+            dsp::AudioBlock<float> block(work);
+            fdn.process(block);
+            
+            outputFifo.prepareToWrite(blockSize, start1, size1, start2, size2);
+            for (int ch = 0; ch < (int) N; ch++)
+            {
+                outputRing.copyFrom(ch, start1, work, ch, 0, size1);
+                if (size2 > 0) outputRing.copyFrom(ch, start2, work, ch, size1, size2);
+            }
+            outputFifo.finishedWrite(blockSize);
+        }
+    }
+};
@@ -0,0 +1,273 @@
+/*
+ ==============================================================================
+
+ Block-wise transposes between the host's planar buffers (one array per
+ channel) and the frame-major buffers of the FDN (all channels of one
+ sample next to each other).
+
+ The loops are templates over a square tile transpose: 4 x 4 with SSE2 or
+ NEON, 8 x 8 with AVX and 16 x 16 with AVX-512. Kernels.h instantiates them
+ per kernel variant, so the tile follows the variant picked at runtime, not
+ the flags the file was compiled with.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+ #define TVFDN_TRANSPOSE_X86 1
+ #include <immintrin.h>
+#else
+ #define TVFDN_TRANSPOSE_X86 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #include <xmmintrin.h>
+ #define TVFDN_TRANSPOSE_SSE2 1
+#else
+ #define TVFDN_TRANSPOSE_SSE2 0
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+ #include <arm_neon.h>
+ #define TVFDN_TRANSPOSE_NEON 1
+#else
+ #define TVFDN_TRANSPOSE_NEON 0
+#endif
+
+namespace FrameTranspose
+{
+    // Each tile transposes `size` x `size` floats: in[k] and out[k] each point to
+    // `size` contiguous floats
+    struct ScalarTile
+    {
+        static constexpr size_t size = 1;
+
+        static inline void transpose(const float* const* in, float* const* out)
+        {
+            out[0][0] = in[0][0];
+        }
+    };
+
+#if TVFDN_TRANSPOSE_SSE2
+    struct SSETile
+    {
+        static constexpr size_t size = 4;
+
+        static inline void transpose(const float* const* in, float* const* out)
+        {
+            __m128 r0 = _mm_loadu_ps(in[0]);
+            __m128 r1 = _mm_loadu_ps(in[1]);
+            __m128 r2 = _mm_loadu_ps(in[2]);
+            __m128 r3 = _mm_loadu_ps(in[3]);
+
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+            _mm_storeu_ps(out[0], r0);
+            _mm_storeu_ps(out[1], r1);
+            _mm_storeu_ps(out[2], r2);
+            _mm_storeu_ps(out[3], r3);
+        }
+    };
+#endif
+
+#if TVFDN_TRANSPOSE_NEON
+    struct NeonTile
+    {
+        static constexpr size_t size = 4;
+
+        static inline void transpose(const float* const* in, float* const* out)
+        {
+            float32x4x2_t t01 = vtrnq_f32(vld1q_f32(in[0]), vld1q_f32(in[1]));
+            float32x4x2_t t23 = vtrnq_f32(vld1q_f32(in[2]), vld1q_f32(in[3]));
+
+            vst1q_f32(out[0], vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])));
+            vst1q_f32(out[1], vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])));
+            vst1q_f32(out[2], vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])));
+            vst1q_f32(out[3], vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])));
+        }
+    };
+#endif
+
+#if TVFDN_TRANSPOSE_X86
+    struct AVXTile
+    {
+        static constexpr size_t size = 8;
+
+        __attribute__((target("avx"))) static inline void transpose(const float* const* in, float* const* out)
+        {
+            __m256 r0 = _mm256_loadu_ps(in[0]);
+            __m256 r1 = _mm256_loadu_ps(in[1]);
+            __m256 r2 = _mm256_loadu_ps(in[2]);
+            __m256 r3 = _mm256_loadu_ps(in[3]);
+            __m256 r4 = _mm256_loadu_ps(in[4]);
+            __m256 r5 = _mm256_loadu_ps(in[5]);
+            __m256 r6 = _mm256_loadu_ps(in[6]);
+            __m256 r7 = _mm256_loadu_ps(in[7]);
+
+            __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+            __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+            __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+            __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+            __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+            __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+            __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+            __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+
+            __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1,0,1,0));
+            __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3,2,3,2));
+            __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1,0,1,0));
+            __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3,2,3,2));
+            __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1,0,1,0));
+            __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3,2,3,2));
+            __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1,0,1,0));
+            __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3,2,3,2));
+
+            _mm256_storeu_ps(out[0], _mm256_permute2f128_ps(s0, s4, 0x20));
+            _mm256_storeu_ps(out[1], _mm256_permute2f128_ps(s1, s5, 0x20));
+            _mm256_storeu_ps(out[2], _mm256_permute2f128_ps(s2, s6, 0x20));
+            _mm256_storeu_ps(out[3], _mm256_permute2f128_ps(s3, s7, 0x20));
+            _mm256_storeu_ps(out[4], _mm256_permute2f128_ps(s0, s4, 0x31));
+            _mm256_storeu_ps(out[5], _mm256_permute2f128_ps(s1, s5, 0x31));
+            _mm256_storeu_ps(out[6], _mm256_permute2f128_ps(s2, s6, 0x31));
+            _mm256_storeu_ps(out[7], _mm256_permute2f128_ps(s3, s7, 0x31));
+        }
+    };
+
+    // the 8 x 8 steps within each 128-bit lane, then two rounds of lane shuffles
+    struct AVX512Tile
+    {
+        static constexpr size_t size = 16;
+
+        __attribute__((target("avx512f"))) static inline void transpose(const float* const* in, float* const* out)
+        {
+            __m512 r[16], t[16], s[16];
+
+            for (int k = 0; k < 16; k++)
+                r[k] = _mm512_loadu_ps(in[k]);
+
+            for (int k = 0; k < 16; k += 2)
+            {
+                t[k] = _mm512_unpacklo_ps(r[k], r[k + 1]);
+                t[k + 1] = _mm512_unpackhi_ps(r[k], r[k + 1]);
+            }
+
+            // lane l of s[4g + m] holds column 4l + m of rows 4g .. 4g + 3
+            for (int g = 0; g < 16; g += 4)
+            {
+                s[g] = _mm512_shuffle_ps(t[g], t[g + 2], _MM_SHUFFLE(1,0,1,0));
+                s[g + 1] = _mm512_shuffle_ps(t[g], t[g + 2], _MM_SHUFFLE(3,2,3,2));
+                s[g + 2] = _mm512_shuffle_ps(t[g + 1], t[g + 3], _MM_SHUFFLE(1,0,1,0));
+                s[g + 3] = _mm512_shuffle_ps(t[g + 1], t[g + 3], _MM_SHUFFLE(3,2,3,2));
+            }
+
+            for (int m = 0; m < 4; m++)
+            {
+                __m512 even0 = _mm512_shuffle_f32x4(s[m], s[4 + m], _MM_SHUFFLE(2,0,2,0));
+                __m512 odd0 = _mm512_shuffle_f32x4(s[m], s[4 + m], _MM_SHUFFLE(3,1,3,1));
+                __m512 even1 = _mm512_shuffle_f32x4(s[8 + m], s[12 + m], _MM_SHUFFLE(2,0,2,0));
+                __m512 odd1 = _mm512_shuffle_f32x4(s[8 + m], s[12 + m], _MM_SHUFFLE(3,1,3,1));
+
+                _mm512_storeu_ps(out[m], _mm512_shuffle_f32x4(even0, even1, _MM_SHUFFLE(2,0,2,0)));
+                _mm512_storeu_ps(out[4 + m], _mm512_shuffle_f32x4(odd0, odd1, _MM_SHUFFLE(2,0,2,0)));
+                _mm512_storeu_ps(out[8 + m], _mm512_shuffle_f32x4(even0, even1, _MM_SHUFFLE(3,1,3,1)));
+                _mm512_storeu_ps(out[12 + m], _mm512_shuffle_f32x4(odd0, odd1, _MM_SHUFFLE(3,1,3,1)));
+            }
+        }
+    };
+#endif
+
+    // the tile of the baseline variant
+#if TVFDN_TRANSPOSE_SSE2
+    using BaselineTile = SSETile;
+#elif TVFDN_TRANSPOSE_NEON
+    using BaselineTile = NeonTile;
+#else
+    using BaselineTile = ScalarTile;
+#endif
+
+    // planar[c][f] -> frames[f * numChannels + c]; channels beyond the last whole tile
+    // and the frames after the last whole tile are copied one by one
+    template <typename Tile>
+    inline void planarToFrames(const float* const* planar, float* frames, size_t numChannels, size_t numFrames)
+    {
+        constexpr size_t tile = Tile::size;
+        const size_t tiledChannels = numChannels - numChannels % tile;
+        size_t f = 0;
+        const float* in[tile];
+        float* out[tile];
+
+        for (; f + tile <= numFrames; f += tile)
+        {
+            for (size_t c = 0; c < tiledChannels; c += tile)
+            {
+                for (size_t k = 0; k < tile; k++)
+                {
+                    in[k] = planar[c + k] + f;
+                    out[k] = frames + (f + k) * numChannels + c;
+                }
+                Tile::transpose(in, out);
+            }
+        }
+
+        for (size_t c = tiledChannels; c < numChannels; c++)
+        {
+            for (size_t g = 0; g < f; g++)
+            {
+                frames[g * numChannels + c] = planar[c][g];
+            }
+        }
+
+        for (; f < numFrames; f++)
+        {
+            for (size_t c = 0; c < numChannels; c++)
+            {
+                frames[f * numChannels + c] = planar[c][f];
+            }
+        }
+    }
+
+    // frames[f * numChannels + c] -> planar[c][f]
+    template <typename Tile>
+    inline void framesToPlanar(const float* frames, float* const* planar, size_t numChannels, size_t numFrames)
+    {
+        constexpr size_t tile = Tile::size;
+        const size_t tiledChannels = numChannels - numChannels % tile;
+        size_t f = 0;
+        const float* in[tile];
+        float* out[tile];
+
+        for (; f + tile <= numFrames; f += tile)
+        {
+            for (size_t c = 0; c < tiledChannels; c += tile)
+            {
+                for (size_t k = 0; k < tile; k++)
+                {
+                    in[k] = frames + (f + k) * numChannels + c;
+                    out[k] = planar[c + k] + f;
+                }
+                Tile::transpose(in, out);
+            }
+        }
+
+        for (size_t c = tiledChannels; c < numChannels; c++)
+        {
+            for (size_t g = 0; g < f; g++)
+            {
+                planar[c][g] = frames[g * numChannels + c];
+            }
+        }
+
+        for (; f < numFrames; f++)
+        {
+            for (size_t c = 0; c < numChannels; c++)
+            {
+                planar[c][f] = frames[f * numChannels + c];
+            }
+        }
+    }
+}
@@ -0,0 +1,674 @@
+/*
+ ==============================================================================
+
+ Per-frame kernels of the FDN (delay I/O, absorption filters, TV FFT and
+ rotation, convolution spectra, dense feedback matrix, subband filter banks, level
+ tracking, host I/O transposes), built once per instruction set and selected at
+ runtime, so one binary runs at full speed on SSE2, AVX2 and AVX-512
+ machines alike.
+
+ Every variant inlines the same plain loops from Kernels::Generic and lets
+ the compiler vectorise them for its own target. GCC and Clang get the x86
+ variants through function target attributes. MSVC has no per-function
+ targets and ARM always has NEON, so those builds have the baseline only.
+
+ The 16-bit delay storage converts with F16C in the x86 AVX variants and
+ with the NEON conversions on AArch64; the SSE2 and scalar baselines
+ convert in software.
+
+ ==============================================================================
+ */
+
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "FrameTranspose.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+ #define TVFDN_KERNELS_X86 1
+ #include <immintrin.h>
+ #include <cpuid.h>
+#else
+ #define TVFDN_KERNELS_X86 0
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+ #define TVFDN_KERNELS_NEON_HALF 1
+ #include <arm_neon.h>
+#else
+ #define TVFDN_KERNELS_NEON_HALF 0
+#endif
+
+namespace Kernels
+{
+    namespace Generic
+    {
+        // out[j] = storage[position[j] - delay[j]], wrapped into the line [begin[j], begin[j] + length[j])
+        forcedinline void readLines(const float* __restrict storage, const int* __restrict position, const int* __restrict delay,
+                                    const int* __restrict begin, const int* __restrict length, float* __restrict out, size_t numLines)
+        {
+            for (size_t j = 0; j < numLines; j++)
+            {
+                int index = position[j] - delay[j];
+                index += index < begin[j] ? length[j] : 0;
+                out[j] = storage[index];
+            }
+        }
+
+        // storage[position[j]] = in[j], then advances every line by one sample
+        forcedinline void writeLines(float* __restrict storage, int* __restrict position, const int* __restrict begin,
+                                     const int* __restrict length, const float* __restrict in, size_t numLines)
+        {
+            for (size_t j = 0; j < numLines; j++)
+            {
+                storage[position[j]] = in[j];
+            }
+
+            for (size_t j = 0; j < numLines; j++)
+            {
+                int next = position[j] + 1;
+                position[j] = next == begin[j] + length[j] ? begin[j] : next;
+            }
+        }
+
+        // the 16-bit variants of readLines/writeLines, for the fp16 and bfloat16 storage.
+        // The lines are gathered (scattered) as raw bits and converted a frame at a time,
+        // so the conversion runs on contiguous vectors
+        template <typename Convert>
+        forcedinline void readLinesPacked(const uint16_t* __restrict storage, const int* __restrict position, const int* __restrict delay,
+                                          const int* __restrict begin, const int* __restrict length, float* __restrict out, size_t numLines)
+        {
+            uint16_t bits[64];
+            
+            for (size_t j0 = 0; j0 < numLines; j0 += 64)
+            {
+                const size_t n = std::min<size_t>(64, numLines - j0);
+                
+                for (size_t j = 0; j < n; j++)
+                {
+                    int index = position[j0 + j] - delay[j0 + j];
+                    index += index < begin[j0 + j] ? length[j0 + j] : 0;
+                    bits[j] = storage[index];
+                }
+                
+                Convert::toFloats(bits, out + j0, n);
+            }
+        }
+        
+        template <typename Convert>
+        forcedinline void writeLinesPacked(uint16_t* __restrict storage, int* __restrict position, const int* __restrict begin,
+                                           const int* __restrict length, const float* __restrict in, size_t numLines)
+        {
+            uint16_t bits[64];
+            
+            for (size_t j0 = 0; j0 < numLines; j0 += 64)
+            {
+                const size_t n = std::min<size_t>(64, numLines - j0);
+                Convert::fromFloats(in + j0, bits, n);
+                
+                for (size_t j = 0; j < n; j++)
+                {
+                    storage[position[j0 + j]] = bits[j];
+                }
+            }
+            
+            for (size_t j = 0; j < numLines; j++)
+            {
+                int next = position[j] + 1;
+                position[j] = next == begin[j] + length[j] ? begin[j] : next;
+            }
+        }
+        
+        forcedinline uint32_t floatBits(float f)      { uint32_t u; std::memcpy(&u, &f, sizeof(u)); return u; }
+        forcedinline float bitsToFloat(uint32_t u)    { float f; std::memcpy(&f, &u, sizeof(f)); return f; }
+        
+        // IEEE half precision without conversion instructions, rounded to nearest even, with
+        // the NaNs of F16C: quieted, the top of the payload kept. Branch-free apart from
+        // selects, so the loops still vectorise
+        struct SoftHalf
+        {
+            static forcedinline uint16_t fromFloat(float f)
+            {
+                const uint32_t u = floatBits(f);
+                const uint32_t sign = (u >> 16) & 0x8000u;
+                const uint32_t a = u & 0x7fffffffu;
+                
+                // normal halves: rebias the exponent, round the 13 dropped mantissa bits
+                const uint32_t normal = (a - ((127u - 15u) << 23) + 0xfffu + ((a >> 13) & 1u)) >> 13;
+                
+                // subnormal halves: let the float adder align and round the mantissa
+                const uint32_t denormalMagic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+                const uint32_t subnormal = floatBits(bitsToFloat(a) + bitsToFloat(denormalMagic)) - denormalMagic;
+                
+                uint32_t h = a < (113u << 23) ? subnormal : normal;
+                h = a >= ((127u + 16u) << 23) ? 0x7c00u : h;         // overflow to infinity
+                h = a > 0x7f800000u ? 0x7e00u | ((a >> 13) & 0x3ffu) : h;   // NaN
+                return (uint16_t) (h | sign);
+            }
+            
+            static forcedinline float toFloat(uint16_t h)
+            {
+                const uint32_t shiftedExponent = 0x7c00u << 13;
+                uint32_t u = ((uint32_t) h & 0x7fffu) << 13;
+                const uint32_t exponent = u & shiftedExponent;
+                u += (127u - 15u) << 23;
+                
+                // subnormal halves are normal floats: renormalise through the float adder
+                const uint32_t subnormal = floatBits(bitsToFloat(u + (1u << 23)) - bitsToFloat(113u << 23));
+                
+                u = exponent == shiftedExponent ? u + ((128u - 16u) << 23) : u;   // infinity and NaN
+                u = exponent == shiftedExponent && (h & 0x3ffu) != 0 ? u | 0x400000u : u;
+                u = exponent == 0 ? subnormal : u;
+                return bitsToFloat(u | (((uint32_t) h & 0x8000u) << 16));
+            }
+            
+            static forcedinline void toFloats(const uint16_t* __restrict in, float* __restrict out, size_t n)
+            {
+                for (size_t i = 0; i < n; i++)
+                    out[i] = toFloat(in[i]);
+            }
+            
+            static forcedinline void fromFloats(const float* __restrict in, uint16_t* __restrict out, size_t n)
+            {
+                for (size_t i = 0; i < n; i++)
+                    out[i] = fromFloat(in[i]);
+            }
+        };
+        
+        // the upper half of a float, rounded to nearest even; the same integer code on every target
+        struct BFloat16
+        {
+            static forcedinline void toFloats(const uint16_t* __restrict in, float* __restrict out, size_t n)
+            {
+                for (size_t i = 0; i < n; i++)
+                    out[i] = bitsToFloat((uint32_t) in[i] << 16);
+            }
+            
+            static forcedinline void fromFloats(const float* __restrict in, uint16_t* __restrict out, size_t n)
+            {
+                for (size_t i = 0; i < n; i++)
+                {
+                    const uint32_t u = floatBits(in[i]);
+                    const uint32_t rounded = (u + 0x7fffu + ((u >> 16) & 1u)) >> 16;
+                    out[i] = (uint16_t) ((u & 0x7fffffffu) > 0x7f800000u ? (u >> 16) | 0x40u : rounded);
+                }
+            }
+        };
+        
+#if TVFDN_KERNELS_NEON_HALF
+        // every AArch64 core converts halves in hardware
+        struct NeonHalf
+        {
+            static forcedinline void toFloats(const uint16_t* __restrict in, float* __restrict out, size_t n)
+            {
+                size_t i = 0;
+                
+                for (; i + 4 <= n; i += 4)
+                    vst1q_f32(out + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(in + i))));
+                
+                for (; i < n; i++)
+                    out[i] = SoftHalf::toFloat(in[i]);
+            }
+            
+            static forcedinline void fromFloats(const float* __restrict in, uint16_t* __restrict out, size_t n)
+            {
+                size_t i = 0;
+                
+                for (; i + 4 <= n; i += 4)
+                    vst1_u16(out + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(in + i))));
+                
+                for (; i < n; i++)
+                    out[i] = SoftHalf::fromFloat(in[i]);
+            }
+        };
+#endif
+        
+#if TVFDN_KERNELS_X86
+        // F16C, present on every AVX2 CPU; AVX-512F has the same conversions on 16 lanes,
+        // which gains nothing for 64 lines
+        struct F16CHalf
+        {
+            __attribute__((target("avx2,fma,f16c"))) static inline void toFloats(const uint16_t* __restrict in, float* __restrict out, size_t n)
+            {
+                size_t i = 0;
+                
+                for (; i + 8 <= n; i += 8)
+                    _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*) (in + i))));
+                
+                for (; i < n; i++)
+                    out[i] = _cvtsh_ss(in[i]);
+            }
+            
+            __attribute__((target("avx2,fma,f16c"))) static inline void fromFloats(const float* __restrict in, uint16_t* __restrict out, size_t n)
+            {
+                size_t i = 0;
+                
+                for (; i + 8 <= n; i += 8)
+                    _mm_storeu_si128((__m128i*) (out + i), _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+                
+                for (; i < n; i++)
+                    out[i] = _cvtss_sh(in[i], _MM_FROUND_TO_NEAREST_INT);
+            }
+        };
+#endif
+        
+        // one first-order filter per line in transposed direct form II, in place on y
+        forcedinline void firstOrderStage(float* __restrict y, const float* __restrict b0, const float* __restrict b1,
+                                          const float* __restrict a1, float* __restrict state, size_t numLines)
+        {
+            for (size_t j = 0; j < numLines; j++)
+            {
+                float x = y[j];
+                float out = b0[j] * x + state[j];
+                state[j] = b1[j] * x - a1[j] * out;
+                y[j] = out;
+            }
+        }
+
+        // one biquad per line in transposed direct form II, in place on y
+        forcedinline void biquadStage(float* __restrict y,
+                                      const float* __restrict b0, const float* __restrict b1, const float* __restrict b2,
+                                      const float* __restrict a1, const float* __restrict a2,
+                                      float* __restrict z1, float* __restrict z2, size_t numLines)
+        {
+            for (size_t j = 0; j < numLines; j++)
+            {
+                float x = y[j];
+                float out = b0[j] * x + z1[j];
+                z1[j] = b1[j] * x - a1[j] * out + z2[j];
+                z2[j] = b2[j] * x - a2[j] * out;
+                y[j] = out;
+            }
+        }
+
+        // multiplies the interleaved complex bins by cos + i sin, in place
+        forcedinline void rotateBins(float* __restrict bins, const float* __restrict cosines, const float* __restrict sines, size_t numBins)
+        {
+            for (size_t b = 0; b < numBins; b++)
+            {
+                float re = bins[2 * b];
+                float im = bins[2 * b + 1];
+                bins[2 * b] = re * cosines[b] - im * sines[b];
+                bins[2 * b + 1] = re * sines[b] + im * cosines[b];
+            }
+        }
+
+        // acc += x * h for interleaved complex spectra
+        forcedinline void spectrumMultiplyAdd(float* __restrict acc, const float* __restrict x, const float* __restrict h, size_t numBins)
+        {
+            for (size_t b = 0; b < numBins; b++)
+            {
+                float xr = x[2 * b], xi = x[2 * b + 1];
+                float hr = h[2 * b], hi = h[2 * b + 1];
+                acc[2 * b] += xr * hr - xi * hi;
+                acc[2 * b + 1] += xr * hi + xi * hr;
+            }
+        }
+
+        // out[c] = sum over k of weights[k] * frames[k * numChannels + c], for the polyphase
+        // filter banks; the channels go in blocks of 16 that stay in registers over all frames
+        forcedinline void weightedFrameSum(const float* __restrict frames, const float* __restrict weights, size_t numFrames,
+                                           float* __restrict out, size_t numChannels)
+        {
+            size_t c0 = 0;
+            
+            for (; c0 + 16 <= numChannels; c0 += 16)
+            {
+                float acc[16] = {};
+                
+                for (size_t k = 0; k < numFrames; k++)
+                {
+                    const float w = weights[k];
+                    const float* frame = frames + k * numChannels + c0;
+                    
+                    for (size_t c = 0; c < 16; c++)
+                    {
+                        acc[c] += w * frame[c];
+                    }
+                }
+                
+                for (size_t c = 0; c < 16; c++)
+                {
+                    out[c0 + c] = acc[c];
+                }
+            }
+            
+            for (size_t c = c0; c < numChannels; c++)
+            {
+                float acc = 0.f;
+                
+                for (size_t k = 0; k < numFrames; k++)
+                {
+                    acc += weights[k] * frames[k * numChannels + c];
+                }
+                
+                out[c] = acc;
+            }
+        }
+        
+        // per channel peak and energy of a block of frames, added to peak/energy; the
+        // channels are the inner loop, so every frame is one pass of vector max/fma
+        forcedinline void trackLevels(const float* __restrict frames, size_t numFrames, size_t numChannels,
+                                      float* __restrict peak, float* __restrict energy)
+        {
+            for (size_t f = 0; f < numFrames; f++)
+            {
+                const float* frame = frames + f * numChannels;
+                
+                for (size_t c = 0; c < numChannels; c++)
+                {
+                    const float magnitude = std::abs(frame[c]);
+                    peak[c] = magnitude > peak[c] ? magnitude : peak[c];
+                    energy[c] += frame[c] * frame[c];
+                }
+            }
+        }
+        
+        // y = x * M for the row vector x and the row-major numRows x numCols matrix M,
+        // accumulated in the same order as dsp::Matrix::operator*
+        forcedinline void matrixProduct(const float* __restrict x, const float* __restrict M, float* __restrict y, size_t numRows, size_t numCols)
+        {
+            for (size_t c = 0; c < numCols; c++)
+            {
+                y[c] = 0.f;
+            }
+
+            for (size_t r = 0; r < numRows; r++)
+            {
+                const float xr = x[r];
+                const float* row = M + r * numCols;
+
+                for (size_t c = 0; c < numCols; c++)
+                {
+                    y[c] += xr * row[c];
+                }
+            }
+        }
+        
+        // one radix-2 Stockham stage of a complex FFT in split format: sub-transforms at
+        // stride s, read from (xr, xi) in two contiguous halves, written to (yr, yi) in order
+        // for the next stage; (wr, wi) hold the twiddle of each butterfly, cos and sin
+        forcedinline void complexFFTStage(const float* __restrict xr, const float* __restrict xi,
+                                          float* __restrict yr, float* __restrict yi,
+                                          const float* __restrict wr, const float* __restrict wi, size_t half, size_t s)
+        {
+            for (size_t i = 0; i < half; i++)
+            {
+                const size_t o = i + (i & ~(s - 1));
+                const float ar = xr[i], ai = xi[i];
+                const float br = xr[i + half], bi = xi[i + half];
+                const float dr = ar - br, di = ai - bi;
+                yr[o] = ar + br;
+                yi[o] = ai + bi;
+                yr[o + s] = dr * wr[i] + di * wi[i];
+                yi[o + s] = di * wr[i] - dr * wi[i];
+            }
+        }
+        
+        // forward complex FFT of m points (a power of two) from (re, im); re and im end up
+        // pointing at whichever of the two buffer pairs holds the result
+        forcedinline void complexFFT(float*& re, float*& im, float*& tr, float*& ti, const float* twiddles, size_t m)
+        {
+            for (size_t s = 1; s < m; s *= 2)
+            {
+                complexFFTStage(re, im, tr, ti, twiddles, twiddles + m / 2, m / 2, s);
+                std::swap(re, tr);
+                std::swap(im, ti);
+                twiddles += m;
+            }
+        }
+        
+        // real FFT of n samples in place (n a power of two, at most 64), through a complex FFT
+        // of the n/2 even/odd pairs. The bins come out interleaved (re, im) as rotateBins takes
+        // them; bin 0 has no imaginary part, so its slot carries the real Nyquist bin instead.
+        // twiddles as laid out by makeRealFFTTwiddles
+        forcedinline void realFFT(float* __restrict data, const float* __restrict twiddles, size_t n)
+        {
+            const size_t m = n / 2;
+            float buffers[4][32];
+            float* re = buffers[0];
+            float* im = buffers[1];
+            float* tr = buffers[2];
+            float* ti = buffers[3];
+            
+            for (size_t k = 0; k < m; k++)
+            {
+                re[k] = data[2 * k];
+                im[k] = data[2 * k + 1];
+            }
+            
+            complexFFT(re, im, tr, ti, twiddles + n, m);
+            
+            // even part E = (Z[k] + conj Z[m-k]) / 2, odd part O = -i (Z[k] - conj Z[m-k]) / 2,
+            // bin k = E + O (cos - i sin)
+            const float* wr = twiddles;
+            const float* wi = twiddles + m;
+            data[0] = re[0] + im[0];
+            data[1] = re[0] - im[0];
+            
+            for (size_t k = 1; k < m; k++)
+            {
+                const float sr = re[k] + re[m - k], si = im[k] - im[m - k];
+                const float dr = re[k] - re[m - k], di = im[k] + im[m - k];
+                data[2 * k] = 0.5f * (sr + di * wr[k] - dr * wi[k]);
+                data[2 * k + 1] = 0.5f * (si - dr * wr[k] - di * wi[k]);
+            }
+        }
+        
+        // inverse of realFFT in place, scaled by 1/n: the complex FFT of the conjugated pairs
+        forcedinline void inverseRealFFT(float* __restrict data, const float* __restrict twiddles, size_t n)
+        {
+            const size_t m = n / 2;
+            const float scale = 0.5f / (float) m;
+            float buffers[4][32];
+            float* re = buffers[0];
+            float* im = buffers[1];
+            float* tr = buffers[2];
+            float* ti = buffers[3];
+            
+            // Z[k] = E + i O with E = (X[k] + conj X[m-k]) / 2, O = (X[k] - conj X[m-k]) (cos + i sin) / 2
+            const float* wr = twiddles;
+            const float* wi = twiddles + m;
+            re[0] = scale * (data[0] + data[1]);
+            im[0] = -scale * (data[0] - data[1]);
+            
+            for (size_t k = 1; k < m; k++)
+            {
+                const float sr = data[2 * k] + data[2 * (m - k)], si = data[2 * k + 1] - data[2 * (m - k) + 1];
+                const float dr = data[2 * k] - data[2 * (m - k)], di = data[2 * k + 1] + data[2 * (m - k) + 1];
+                re[k] = scale * (sr - dr * wi[k] - di * wr[k]);
+                im[k] = -scale * (si + dr * wr[k] - di * wi[k]);
+            }
+            
+            complexFFT(re, im, tr, ti, twiddles + n, m);
+            
+            for (size_t k = 0; k < m; k++)
+            {
+                data[2 * k] = re[k];
+                data[2 * k + 1] = -im[k];
+            }
+        }
+    }
+    
+    // twiddles for realFFT and inverseRealFFT of n samples: cos and sin of 2 pi k / n for the
+    // n/2 bins, then per Stockham stage of the n/2-point complex FFT cos and sin per butterfly
+    inline std::vector<float> makeRealFFTTwiddles(size_t n)
+    {
+        const size_t m = n / 2;
+        std::vector<float> twiddles(2 * m);
+        
+        for (size_t k = 0; k < m; k++)
+        {
+            const double angle = juce::MathConstants<double>::twoPi * (double) k / (double) n;
+            twiddles[k] = (float) std::cos(angle);
+            twiddles[m + k] = (float) std::sin(angle);
+        }
+        
+        for (size_t s = 1; s < m; s *= 2)
+        {
+            const size_t begin = twiddles.size();
+            twiddles.resize(begin + m);
+            
+            for (size_t i = 0; i < m / 2; i++)
+            {
+                const double angle = juce::MathConstants<double>::twoPi * (double) (i / s) * (double) s / (double) m;
+                twiddles[begin + i] = (float) std::cos(angle);
+                twiddles[begin + m / 2 + i] = (float) std::sin(angle);
+            }
+        }
+        
+        return twiddles;
+    }
+
+    struct Variant
+    {
+        const char* name;
+        bool (*isSupported)();
+
+        void (*readLines)(const float*, const int*, const int*, const int*, const int*, float*, size_t);
+        void (*writeLines)(float*, int*, const int*, const int*, const float*, size_t);
+        void (*firstOrderStage)(float*, const float*, const float*, const float*, float*, size_t);
+        void (*biquadStage)(float*, const float*, const float*, const float*, const float*, const float*, float*, float*, size_t);
+        void (*rotateBins)(float*, const float*, const float*, size_t);
+        void (*spectrumMultiplyAdd)(float*, const float*, const float*, size_t);
+        void (*matrixProduct)(const float*, const float*, float*, size_t, size_t);
+        void (*realFFT)(float*, const float*, size_t);
+        void (*inverseRealFFT)(float*, const float*, size_t);
+        void (*weightedFrameSum)(const float*, const float*, size_t, float*, size_t);
+        void (*trackLevels)(const float*, size_t, size_t, float*, float*);
+        void (*planarToFrames)(const float* const*, float*, size_t, size_t);
+        void (*framesToPlanar)(const float*, float* const*, size_t, size_t);
+        void (*readLinesHalf)(const uint16_t*, const int*, const int*, const int*, const int*, float*, size_t);
+        void (*writeLinesHalf)(uint16_t*, int*, const int*, const int*, const float*, size_t);
+        void (*readLinesBFloat16)(const uint16_t*, const int*, const int*, const int*, const int*, float*, size_t);
+        void (*writeLinesBFloat16)(uint16_t*, int*, const int*, const int*, const float*, size_t);
+    };
+
+// instantiates the generic kernels in namespace ns, compiled with the given function attributes;
+// half is the fp16 conversion the target has, tile its widest FrameTranspose tile
+#define TVFDN_KERNEL_VARIANT(ns, attributes, half, tile) \
+    namespace ns \
+    { \
+        attributes inline void readLines(const float* s, const int* p, const int* d, const int* b, const int* l, float* o, size_t n) \
+            { Generic::readLines(s, p, d, b, l, o, n); } \
+        attributes inline void writeLines(float* s, int* p, const int* b, const int* l, const float* i, size_t n) \
+            { Generic::writeLines(s, p, b, l, i, n); } \
+        attributes inline void readLinesHalf(const uint16_t* s, const int* p, const int* d, const int* b, const int* l, float* o, size_t n) \
+            { Generic::readLinesPacked<half>(s, p, d, b, l, o, n); } \
+        attributes inline void writeLinesHalf(uint16_t* s, int* p, const int* b, const int* l, const float* i, size_t n) \
+            { Generic::writeLinesPacked<half>(s, p, b, l, i, n); } \
+        attributes inline void readLinesBFloat16(const uint16_t* s, const int* p, const int* d, const int* b, const int* l, float* o, size_t n) \
+            { Generic::readLinesPacked<Generic::BFloat16>(s, p, d, b, l, o, n); } \
+        attributes inline void writeLinesBFloat16(uint16_t* s, int* p, const int* b, const int* l, const float* i, size_t n) \
+            { Generic::writeLinesPacked<Generic::BFloat16>(s, p, b, l, i, n); } \
+        attributes inline void firstOrderStage(float* y, const float* b0, const float* b1, const float* a1, float* z, size_t n) \
+            { Generic::firstOrderStage(y, b0, b1, a1, z, n); } \
+        attributes inline void biquadStage(float* y, const float* b0, const float* b1, const float* b2, const float* a1, const float* a2, float* z1, float* z2, size_t n) \
+            { Generic::biquadStage(y, b0, b1, b2, a1, a2, z1, z2, n); } \
+        attributes inline void rotateBins(float* x, const float* c, const float* s, size_t n) \
+            { Generic::rotateBins(x, c, s, n); } \
+        attributes inline void spectrumMultiplyAdd(float* a, const float* x, const float* h, size_t n) \
+            { Generic::spectrumMultiplyAdd(a, x, h, n); } \
+        attributes inline void matrixProduct(const float* x, const float* M, float* y, size_t r, size_t c) \
+            { Generic::matrixProduct(x, M, y, r, c); } \
+        attributes inline void realFFT(float* x, const float* w, size_t n) \
+            { Generic::realFFT(x, w, n); } \
+        attributes inline void inverseRealFFT(float* x, const float* w, size_t n) \
+            { Generic::inverseRealFFT(x, w, n); } \
+        attributes inline void weightedFrameSum(const float* f, const float* w, size_t k, float* o, size_t c) \
+            { Generic::weightedFrameSum(f, w, k, o, c); } \
+        attributes inline void trackLevels(const float* f, size_t k, size_t c, float* p, float* e) \
+            { Generic::trackLevels(f, k, c, p, e); } \
+        attributes inline void planarToFrames(const float* const* p, float* f, size_t c, size_t k) \
+            { FrameTranspose::planarToFrames<tile>(p, f, c, k); } \
+        attributes inline void framesToPlanar(const float* f, float* const* p, size_t c, size_t k) \
+            { FrameTranspose::framesToPlanar<tile>(f, p, c, k); } \
+    }
+
+#if TVFDN_KERNELS_NEON_HALF
+    TVFDN_KERNEL_VARIANT(Baseline, , Generic::NeonHalf, FrameTranspose::BaselineTile)
+#else
+    TVFDN_KERNEL_VARIANT(Baseline, , Generic::SoftHalf, FrameTranspose::BaselineTile)
+#endif
+
+#if TVFDN_KERNELS_X86
+    TVFDN_KERNEL_VARIANT(AVX2, __attribute__((target("avx2,fma,f16c"))), Generic::F16CHalf, FrameTranspose::AVXTile)
+    TVFDN_KERNEL_VARIANT(AVX512, __attribute__((target("avx512f,avx512vl,avx2,fma,f16c"))), Generic::F16CHalf, FrameTranspose::AVX512Tile)
+#endif
+
+#undef TVFDN_KERNEL_VARIANT
+
+    inline bool alwaysSupported()  { return true; }
+#if TVFDN_KERNELS_X86
+    // JUCE does not report F16C; CPUID leaf 1, ECX bit 29
+    inline bool hasF16C()
+    {
+        unsigned int eax, ebx, ecx, edx;
+        return __get_cpuid(1, &eax, &ebx, &ecx, &edx) != 0 && (ecx & (1u << 29)) != 0;
+    }
+#else
+    inline bool hasF16C()          { return false; }
+#endif
+
+    // the AVX variants are compiled for F16C as well
+    inline bool hasAVX2()          { return juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3() && hasF16C(); }
+    inline bool hasAVX512()        { return hasAVX2() && juce::SystemStats::hasAVX512F() && juce::SystemStats::hasAVX512VL(); }
+
+#define TVFDN_KERNEL_ENTRY(name, ns, isSupported) \
+    { name, isSupported, ns::readLines, ns::writeLines, ns::firstOrderStage, ns::biquadStage, ns::rotateBins, ns::spectrumMultiplyAdd, ns::matrixProduct, ns::realFFT, ns::inverseRealFFT, ns::weightedFrameSum, ns::trackLevels, \
+      ns::planarToFrames, ns::framesToPlanar, ns::readLinesHalf, ns::writeLinesHalf, ns::readLinesBFloat16, ns::writeLinesBFloat16 }
+
+    // in order of preference, the baseline first
+    inline const Variant variants[] {
+#if TVFDN_KERNELS_X86 || defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+        TVFDN_KERNEL_ENTRY("sse2", Baseline, alwaysSupported),
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+        TVFDN_KERNEL_ENTRY("neon", Baseline, alwaysSupported),
+#else
+        TVFDN_KERNEL_ENTRY("scalar", Baseline, alwaysSupported),
+#endif
+#if TVFDN_KERNELS_X86
+        TVFDN_KERNEL_ENTRY("avx2", AVX2, hasAVX2),
+        TVFDN_KERNEL_ENTRY("avx512", AVX512, hasAVX512),
+#endif
+    };
+
+#undef TVFDN_KERNEL_ENTRY
+
+    inline const Variant& getBaseline()
+    {
+        return variants[0];
+    }
+
+    // the most capable variant this CPU supports
+    inline const Variant& getBest()
+    {
+        const Variant* best = &variants[0];
+
+        for (auto& variant : variants)
+        {
+            if (variant.isSupported())
+                best = &variant;
+        }
+
+        return *best;
+    }
+
+    // the variant named by the TVFDN_KERNELS environment variable (e.g. "avx2"),
+    // or nullptr if unset, unknown or not supported by this CPU
+    inline const Variant* getOverride()
+    {
+        auto name = juce::SystemStats::getEnvironmentVariable("TVFDN_KERNELS", {});
+
+        for (auto& variant : variants)
+        {
+            if (name == variant.name && variant.isSupported())
+                return &variant;
+        }
+
+        return nullptr;
+    }
+}
@@ -9,6 +9,11 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+// one reverberation time per octave band of MultiBandAbsorptionFilters::bandFrequencies
+static const char* const rtBandParameterIDs[MultiBandAbsorptionFilters::numBands] {
+    "RT_63Hz", "RT_125Hz", "RT_250Hz", "RT_500Hz", "RT_1kHz", "RT_2kHz", "RT_4kHz", "RT_8kHz"
+};
+
 
 //==============================================================================
 GlivelabPlugin64AudioProcessor::GlivelabPlugin64AudioProcessor()
@@ -108,13 +113,29 @@ void GlivelabPlugin64AudioProcessor::prepareToPlay (double sampleRate, int sampl
     filterSpec = spec;
     filterSpec.numChannels = 1;
     
-    count++;
-    if (count == 1)
+    // a mode requested with setAsyncProcessing takes effect here
+    asyncFDN.stop();
+    asyncRunning = asyncProcessing.load();
+    
+    if (asyncRunning)
+    {
+        asyncFDN.prepare(spec, filterSpec, (size_t) asyncBlockSize.load(), (size_t) getTotalNumInputChannels(), (size_t) getTotalNumOutputChannels());
+        setLatencySamples(asyncFDN.getLatencySamples());
+    }
+    else
+    {
         fdn.prepare(spec,filterSpec);
+        fdn.setNumChannels(getTotalNumInputChannels(), getTotalNumOutputChannels());
+        setLatencySamples(0);
+    }
+    
+    hostValuesValid = false;
     
 }
 void GlivelabPlugin64AudioProcessor::releaseResources()
 {
+    asyncFDN.stop();
+
     // When playback stops, you can use this as an opportunity to free up any
     // spare memory, etc.
 }
@@ -122,7 +143,11 @@ void GlivelabPlugin64AudioProcessor::releaseResources()
 #ifndef JucePlugin_PreferredChannelConfigurations
 bool GlivelabPlugin64AudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
 {
-    return true;
+    // up to 64 channels each way; channels that are not connected are skipped by the FDN
+    auto numInputs  = layouts.getMainInputChannelSet().size();
+    auto numOutputs = layouts.getMainOutputChannelSet().size();
+    
+    return numInputs <= 64 && numOutputs > 0 && numOutputs <= 64;
 
 }
 #endif
@@ -140,19 +165,221 @@ void GlivelabPlugin64AudioProcessor::processBlock (juce::AudioBuffer<float>& buf
 
     juce::dsp::AudioBlock<float> block (buffer);
 
-    fdn.RT_DC  = *apvts.getRawParameterValue("RT_DC");
-    fdn.RT_NY =  *apvts.getRawParameterValue("RT_NY");
-    fdn.RT_CrossOverFrequency =  *apvts.getRawParameterValue("RT_CrossOverFrequency");
-    fdn.TVBypassed = *apvts.getRawParameterValue("TV Bypassed");
-    fdn.AbsorptionBypassed = *apvts.getRawParameterValue("Absorption Bypassed");
-    fdn.osc_frequency  = *apvts.getRawParameterValue("Osc_Frequency");
-    fdn.delayFactor = *apvts.getRawParameterValue("Delay_Factor");
-    fdn.spread = *apvts.getRawParameterValue("Frequency Spread");
-
-   fdn.process(block);
+    FDNParameters params;
+    params.RT_DC  = *apvts.getRawParameterValue("RT_DC");
+    params.RT_NY =  *apvts.getRawParameterValue("RT_NY");
+    params.RT_CrossOverFrequency =  *apvts.getRawParameterValue("RT_CrossOverFrequency");
+    params.TVBypassed = *apvts.getRawParameterValue("TV Bypassed");
+    params.AbsorptionBypassed = *apvts.getRawParameterValue("Absorption Bypassed");
+    params.osc_frequency  = *apvts.getRawParameterValue("Osc_Frequency");
+    params.delayFactor = *apvts.getRawParameterValue("Delay_Factor");
+    params.spread = *apvts.getRawParameterValue("Frequency Spread");
+    params.MultiBandAbsorption = *apvts.getRawParameterValue("MultiBand Absorption");
+    
+    for (size_t k = 0; k < MultiBandAbsorptionFilters::numBands; ++k)
+        params.RT_Bands[k] = *apvts.getRawParameterValue(rtBandParameterIDs[k]);
+    
+    params.EarlyReflections = *apvts.getRawParameterValue("Early Reflections");
+    params.SubbandMode = *apvts.getRawParameterValue("Subband Mode");
+    params.AdaptiveOrder = *apvts.getRawParameterValue("Adaptive Order");
+
+    if (asyncRunning)
+    {
+        // dropped, see scheduleParameter
+        scheduledFifo.finishedRead (scheduledFifo.getNumReady());
+        asyncFDN.setParameters(params);
+        asyncFDN.process(block);
+    }
+    else
+    {
+        scheduleQueuedPoints();
+        applyHostParameters(params, buffer.getNumSamples());
+        fdn.process(block);
+    }
    
 }
 
+bool GlivelabPlugin64AudioProcessor::scheduleParameter (AutomationParameter parameter, float value, int sampleOffset)
+{
+    if (! isPositiveAndBelow ((int) parameter, (int) AutomationParameter::numParameters) || ! std::isfinite (value) || sampleOffset < 0)
+        return false;
+
+    int start1, size1, start2, size2;
+    scheduledFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+    if (size1 == 0)
+        return false;
+
+    scheduledPoints[(size_t) start1] = { parameter, value, sampleOffset };
+    scheduledFifo.finishedWrite (1);
+    return true;
+}
+
+// audio thread: the queued points join the FDN's own queue, counted from this block
+void GlivelabPlugin64AudioProcessor::scheduleQueuedPoints()
+{
+    int start1, size1, start2, size2;
+    scheduledFifo.prepareToRead (scheduledFifo.getNumReady(), start1, size1, start2, size2);
+
+    for (int k = 0; k < size1 + size2; ++k)
+    {
+        auto& point = scheduledPoints[(size_t) (k < size1 ? start1 + k : start2 + k - size1)];
+        fdn.scheduleParameter (point.parameter, point.value, (size_t) point.sampleOffset);
+    }
+
+    scheduledFifo.finishedRead (size1 + size2);
+}
+
+// JUCE hands the host automation over without timestamps. A change of a ramped parameter
+// (see FDN::isRamped) becomes a point at the last sample of the block, so it glides over
+// the block in the same per-sample ramps as scheduled points instead of stepping; the
+// switches, Delay_Factor and the band RTs change at the start of the block
+void GlivelabPlugin64AudioProcessor::applyHostParameters (const FDNParameters& params, int numSamples)
+{
+    for (int p = 0; p < (int) AutomationParameter::numParameters; ++p)
+    {
+        auto parameter = (AutomationParameter) p;
+        auto value = params.get (parameter);
+
+        if (hostValuesValid && value == hostValues[(size_t) p])
+            continue;
+
+        hostValues[(size_t) p] = value;
+
+        if (fdn.hasPendingEvents (parameter))
+            continue;
+
+        if (hostValuesValid && FDN::isRamped (parameter) && numSamples > 0)
+            fdn.scheduleParameter (parameter, value, (size_t) numSamples - 1);
+        else
+            fdn.setParameter (parameter, value);
+    }
+
+    hostValuesValid = true;
+}
+
+float GlivelabPlugin64AudioProcessor::getLinePeakLevel (int line) const
+{
+    if (! isPositiveAndBelow (line, (int) fdn.N))
+        return 0.f;
+
+    return fdn.watchdog.linePeakLevels[(size_t) line].load (std::memory_order_relaxed);
+}
+
+float GlivelabPlugin64AudioProcessor::getLineRmsLevel (int line) const
+{
+    if (! isPositiveAndBelow (line, (int) fdn.N))
+        return 0.f;
+
+    return fdn.watchdog.lineRmsLevels[(size_t) line].load (std::memory_order_relaxed);
+}
+
+float GlivelabPlugin64AudioProcessor::getFeedbackGain() const
+{
+    return fdn.watchdog.gainLevel.load (std::memory_order_relaxed);
+}
+
+int GlivelabPlugin64AudioProcessor::getNumWatchdogResets() const
+{
+    return fdn.watchdog.numResets.load (std::memory_order_relaxed);
+}
+
+bool GlivelabPlugin64AudioProcessor::loadEarlyReflections (const File& file)
+{
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    std::unique_ptr<AudioFormatReader> reader (formatManager.createReaderFor (file));
+
+    if (reader == nullptr)
+        return false;
+
+    auto maxLength = (int64) (EarlyReflectionConvolver::maxLengthSeconds * reader->sampleRate);
+    AudioBuffer<float> ir ((int) reader->numChannels, (int) jmin (reader->lengthInSamples, maxLength));
+    reader->read (&ir, 0, ir.getNumSamples(), 0, true, true);
+
+    // partitioned in the background, processing continues with the old IR meanwhile
+    fdn.setEarlyReflections (ir, reader->sampleRate);
+
+    return true;
+}
+
+void GlivelabPlugin64AudioProcessor::clearEarlyReflections()
+{
+    fdn.setEarlyReflections ({}, getSampleRate());
+}
+
+void GlivelabPlugin64AudioProcessor::setAsyncProcessing (bool enabled, int internalBlockSize)
+{
+    asyncBlockSize = jmax (1, internalBlockSize);
+    asyncProcessing = enabled;
+
+    // Only the host may re-prepare: reporting the latency of the requested mode makes it
+    // restart processing, and the next prepareToPlay switches over
+    if (getSampleRate() > 0.0 && getBlockSize() > 0)
+        setLatencySamples (enabled ? AsyncFDN::getLatencySamples ((size_t) asyncBlockSize.load(), (size_t) getBlockSize()) : 0);
+}
+
+void GlivelabPlugin64AudioProcessor::setDelayPrecision (Delays::Precision precision)
+{
+    // the lines are allocated here and swapped in by the next block, synchronous or async
+    fdn.setDelayPrecision (precision);
+}
+
+void GlivelabPlugin64AudioProcessor::enableSignalTrace (int signals, double seconds, const File& directory)
+{
+    // the rings are allocated here, the next block arms them
+    fdn.enableTracing (signals, seconds, directory);
+}
+
+void GlivelabPlugin64AudioProcessor::disableSignalTrace()
+{
+    fdn.disableTracing();
+}
+
+void GlivelabPlugin64AudioProcessor::triggerSignalTrace()
+{
+    fdn.triggerTrace();
+}
+
+int GlivelabPlugin64AudioProcessor::getNumSignalTraces() const
+{
+    return fdn.tracer.numDumps.load (std::memory_order_relaxed);
+}
+
+bool GlivelabPlugin64AudioProcessor::isAsyncProcessing() const
+{
+    return asyncRunning;
+}
+
+int GlivelabPlugin64AudioProcessor::getNumAsyncUnderruns() const
+{
+    return asyncFDN.numUnderruns.load (std::memory_order_relaxed);
+}
+
+const char* GlivelabPlugin64AudioProcessor::getKernelVariant() const
+{
+    return fdn.kernelName.load (std::memory_order_relaxed);
+}
+
+int GlivelabPlugin64AudioProcessor::getProcessingBlockSize() const
+{
+    return fdn.blockSizeLevel.load (std::memory_order_relaxed);
+}
+
+int GlivelabPlugin64AudioProcessor::getCurrentOrder() const
+{
+    return fdn.orderLevel.load (std::memory_order_relaxed);
+}
+
+bool GlivelabPlugin64AudioProcessor::morphFeedbackMatrix (const float* matrix, double seconds)
+{
+    return matrix != nullptr && fdn.morphFeedbackMatrix (matrix, seconds);
+}
+
+float GlivelabPlugin64AudioProcessor::getMatrixMorphProgress() const
+{
+    return fdn.morph.progress.load (std::memory_order_relaxed);
+}
 
 //==============================================================================
 bool GlivelabPlugin64AudioProcessor::hasEditor() const
@@ -211,6 +438,17 @@ juce::AudioProcessorValueTreeState::ParameterLayout GlivelabPlugin64AudioProcess
     
     layout.add(std::make_unique<juce::AudioParameterBool>("TV Bypassed", "TV Bypassed", false));
     layout.add(std::make_unique<juce::AudioParameterBool>("Absorption Bypassed", "Absorption Bypassed", false));
+    
+    layout.add(std::make_unique<juce::AudioParameterBool>("MultiBand Absorption", "MultiBand Absorption", false));
+    layout.add(std::make_unique<juce::AudioParameterBool>("Early Reflections", "Early Reflections", false));
+    layout.add(std::make_unique<juce::AudioParameterBool>("Subband Mode", "Subband Mode", false));
+    layout.add(std::make_unique<juce::AudioParameterBool>("Adaptive Order", "Adaptive Order", false));
+    
+    for (size_t k = 0; k < MultiBandAbsorptionFilters::numBands; ++k)
+        layout.add(std::make_unique<juce::AudioParameterFloat>(rtBandParameterIDs[k],
+                                                               rtBandParameterIDs[k],
+                                                               juce::NormalisableRange<float>(0.5f,10.f,0.1f,1.f),
+                                                               MultiBandAbsorptionFilters::defaultRT[k]));
  
     return layout;
 }
@@ -0,0 +1,314 @@
+/*
+ ==============================================================================
+
+ Plain C interface to the TVFDN engine.
+
+ ==============================================================================
+ */
+
+#include "tvfdn.h"
+#include "FDN.h"
+
+struct tvfdn_engine
+{
+    FDN fdn{};
+
+    // written by tvfdn_set_param from any thread, read at the start of each block
+    std::array<std::atomic<float>, TVFDN_NUM_PARAMS> params;
+
+    AudioBuffer<float> buffer;
+    int numInputs = 0;
+    int numOutputs = 0;
+    int maximumBlockSize = 0;
+    bool prepared = false;
+};
+
+// same ranges as the plugin parameters
+static const Range<float> paramRanges[TVFDN_NUM_PARAMS] {
+    { 0.5f, 10.f },     // RT_DC
+    { 0.5f, 10.f },     // RT_NY
+    { 100.f, 8000.f },  // RT_CrossOverFrequency
+    { 0.1f, 10.f },     // Osc_Frequency
+    { 0.5f, 5.f },      // Delay_Factor
+    { 0.1f, 1.f },      // Frequency Spread
+    { 0.f, 1.f },       // TV Bypassed
+    { 0.f, 1.f },       // Absorption Bypassed
+    { 0.f, 1.f },       // MultiBand Absorption
+    { 0.5f, 10.f },     // RT_63Hz
+    { 0.5f, 10.f },     // RT_125Hz
+    { 0.5f, 10.f },     // RT_250Hz
+    { 0.5f, 10.f },     // RT_500Hz
+    { 0.5f, 10.f },     // RT_1kHz
+    { 0.5f, 10.f },     // RT_2kHz
+    { 0.5f, 10.f },     // RT_4kHz
+    { 0.5f, 10.f },     // RT_8kHz
+    { 0.f, 1.f },       // Early Reflections
+    { 0.f, 1.f },       // Subband Mode
+    { 0.f, 1.f }        // Adaptive Order
+};
+
+static_assert ((int) AutomationParameter::numParameters == TVFDN_NUM_PARAMS, "the automation numbers the parameters as the C API");
+
+static void applyParams (tvfdn_engine& engine)
+{
+    auto& fdn = engine.fdn;
+
+    // automated parameters follow their points until the last one has passed
+    for (int p = 0; p < TVFDN_NUM_PARAMS; ++p)
+        if (! fdn.hasPendingEvents ((AutomationParameter) p))
+            fdn.setParameter ((AutomationParameter) p, engine.params[(size_t) p].load (std::memory_order_relaxed));
+}
+
+tvfdn_engine* tvfdn_create (void)
+{
+    auto* engine = new (std::nothrow) tvfdn_engine();
+
+    if (engine == nullptr)
+        return nullptr;
+
+    // start from the engine defaults
+    auto& fdn = engine->fdn;
+    engine->params[TVFDN_PARAM_RT_DC] = fdn.RT_DC;
+    engine->params[TVFDN_PARAM_RT_NY] = fdn.RT_NY;
+    engine->params[TVFDN_PARAM_RT_CROSSOVER_FREQUENCY] = fdn.RT_CrossOverFrequency;
+    engine->params[TVFDN_PARAM_OSC_FREQUENCY] = fdn.osc_frequency;
+    engine->params[TVFDN_PARAM_DELAY_FACTOR] = fdn.delayFactor;
+    engine->params[TVFDN_PARAM_FREQUENCY_SPREAD] = fdn.spread;
+    engine->params[TVFDN_PARAM_TV_BYPASSED] = fdn.TVBypassed ? 1.f : 0.f;
+    engine->params[TVFDN_PARAM_ABSORPTION_BYPASSED] = fdn.AbsorptionBypassed ? 1.f : 0.f;
+    engine->params[TVFDN_PARAM_MULTIBAND_ABSORPTION] = fdn.MultiBandAbsorption ? 1.f : 0.f;
+    engine->params[TVFDN_PARAM_EARLY_REFLECTIONS] = fdn.EarlyReflections ? 1.f : 0.f;
+    engine->params[TVFDN_PARAM_SUBBAND_MODE] = fdn.SubbandMode ? 1.f : 0.f;
+    engine->params[TVFDN_PARAM_ADAPTIVE_ORDER] = fdn.AdaptiveOrder ? 1.f : 0.f;
+
+    for (size_t k = 0; k < MultiBandAbsorptionFilters::numBands; ++k)
+        engine->params[TVFDN_PARAM_RT_63HZ + k] = fdn.RT_Bands[k];
+
+    return engine;
+}
+
+void tvfdn_destroy (tvfdn_engine* engine)
+{
+    delete engine;
+}
+
+tvfdn_result tvfdn_prepare (tvfdn_engine* engine, double sampleRate, int maximumBlockSize, int numInputs, int numOutputs)
+{
+    if (engine == nullptr || sampleRate <= 0.0 || maximumBlockSize <= 0
+        || numInputs < 0 || numInputs > TVFDN_NUM_CHANNELS
+        || numOutputs <= 0 || numOutputs > TVFDN_NUM_CHANNELS)
+        return TVFDN_ERROR_INVALID_ARGUMENT;
+
+    dsp::ProcessSpec spec;
+    spec.sampleRate = sampleRate;
+    spec.maximumBlockSize = (uint32) maximumBlockSize;
+    spec.numChannels = (uint32) jmax (numInputs, 1);
+
+    dsp::ProcessSpec filterSpec = spec;
+    filterSpec.numChannels = 1;
+
+    engine->buffer.setSize (jmax (numInputs, numOutputs), maximumBlockSize, false, true, true);
+    engine->numInputs = numInputs;
+    engine->numOutputs = numOutputs;
+    engine->maximumBlockSize = maximumBlockSize;
+
+    engine->fdn.prepare (spec, filterSpec);
+    engine->fdn.setNumChannels ((size_t) numInputs, (size_t) numOutputs);
+    engine->prepared = true;
+
+    return TVFDN_OK;
+}
+
+tvfdn_result tvfdn_set_early_reflections (tvfdn_engine* engine, const float* const* ir, int numChannels, int numSamples, double sampleRate)
+{
+    if (engine == nullptr || numSamples < 0 || (numSamples > 0 && (ir == nullptr || numChannels <= 0 || sampleRate <= 0.0)))
+        return TVFDN_ERROR_INVALID_ARGUMENT;
+
+    AudioBuffer<float> buffer;
+
+    if (numSamples > 0)
+    {
+        auto length = jmin (numSamples, (int) (EarlyReflectionConvolver::maxLengthSeconds * sampleRate) + 1);
+        buffer.setSize (jmin (numChannels, TVFDN_NUM_CHANNELS), length);
+
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            buffer.copyFrom (ch, 0, ir[ch], length);
+    }
+
+    engine->fdn.setEarlyReflections (buffer, sampleRate);
+
+    return TVFDN_OK;
+}
+
+tvfdn_result tvfdn_set_delay_precision (tvfdn_engine* engine, tvfdn_delay_precision precision)
+{
+    if (engine == nullptr || precision < TVFDN_DELAY_FLOAT32 || precision > TVFDN_DELAY_BFLOAT16)
+        return TVFDN_ERROR_INVALID_ARGUMENT;
+
+    engine->fdn.setDelayPrecision ((Delays::Precision) precision);
+
+    return TVFDN_OK;
+}
+
+tvfdn_result tvfdn_enable_trace (tvfdn_engine* engine, int signals, double seconds, const char* directory)
+{
+    if (engine == nullptr || (signals & ~TVFDN_TRACE_ALL) != 0 || signals == 0 || ! (seconds > 0.0) || directory == nullptr)
+        return TVFDN_ERROR_INVALID_ARGUMENT;
+
+    if (! engine->prepared)
+        return TVFDN_ERROR_NOT_PREPARED;
+
+    engine->fdn.enableTracing (signals, seconds, File (String::fromUTF8 (directory)));
+
+    return TVFDN_OK;
+}
+
+void tvfdn_disable_trace (tvfdn_engine* engine)
+{
+    if (engine != nullptr)
+        engine->fdn.disableTracing();
+}
+
+void tvfdn_trigger_trace (tvfdn_engine* engine)
+{
+    if (engine != nullptr)
+        engine->fdn.triggerTrace();
+}
+
+int tvfdn_get_num_traces (const tvfdn_engine* engine)
+{
+    return engine != nullptr ? engine->fdn.tracer.numDumps.load (std::memory_order_relaxed) : 0;
+}
+
+tvfdn_result tvfdn_set_param (tvfdn_engine* engine, tvfdn_param param, float value)
+{
+    if (engine == nullptr || param < 0 || param >= TVFDN_NUM_PARAMS || ! std::isfinite (value))
+        return TVFDN_ERROR_INVALID_ARGUMENT;
+
+    auto range = paramRanges[param];
+    engine->params[(size_t) param].store (jlimit (range.getStart(), range.getEnd(), value), std::memory_order_relaxed);
+
+    return TVFDN_OK;
+}
+
+tvfdn_result tvfdn_schedule_param (tvfdn_engine* engine, tvfdn_param param, float value, int sampleOffset)
+{
+    if (engine == nullptr || param < 0 || param >= TVFDN_NUM_PARAMS || ! std::isfinite (value) || sampleOffset < 0)
+        return TVFDN_ERROR_INVALID_ARGUMENT;
+
+    auto range = paramRanges[param];
+    value = jlimit (range.getStart(), range.getEnd(), value);
+
+    auto& fdn = engine->fdn;
+
+    if (! fdn.scheduleParameter ((AutomationParameter) param, value, (size_t) sampleOffset))
+        return TVFDN_ERROR_INVALID_ARGUMENT;
+
+    // the parameter stays at the value of its last point
+    bool last = true;
+
+    for (size_t k = 0; k < fdn.numAutomationEvents; ++k)
+        last = last && ! (fdn.automationEvents[k].parameter == (AutomationParameter) param && fdn.automationEvents[k].sample > (size_t) sampleOffset);
+
+    if (last)
+        engine->params[(size_t) param].store (value, std::memory_order_relaxed);
+
+    return TVFDN_OK;
+}
+
+float tvfdn_get_param (const tvfdn_engine* engine, tvfdn_param param)
+{
+    if (engine == nullptr || param < 0 || param >= TVFDN_NUM_PARAMS)
+        return 0.f;
+
+    return engine->params[(size_t) param].load (std::memory_order_relaxed);
+}
+
+tvfdn_result tvfdn_process (tvfdn_engine* engine, const float* const* inputs, float* const* outputs, int numSamples)
+{
+    if (engine == nullptr || numSamples < 0 || outputs == nullptr || (inputs == nullptr && engine->numInputs > 0))
+        return TVFDN_ERROR_INVALID_ARGUMENT;
+
+    if (! engine->prepared)
+        return TVFDN_ERROR_NOT_PREPARED;
+
+    ScopedNoDenormals noDenormals;
+
+    auto& buffer = engine->buffer;
+
+    // the host buffers may be longer than the prepared block size
+    for (int start = 0; start < numSamples; start += engine->maximumBlockSize)
+    {
+        auto numThisTime = jmin (engine->maximumBlockSize, numSamples - start);
+
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        {
+            if (ch < engine->numInputs)
+                buffer.copyFrom (ch, 0, inputs[ch] + start, numThisTime);
+            else
+                buffer.clear (ch, 0, numThisTime);
+        }
+
+        applyParams (*engine);
+
+        dsp::AudioBlock<float> block (buffer);
+        engine->fdn.process (block.getSubBlock (0, (size_t) numThisTime));
+
+        for (int ch = 0; ch < engine->numOutputs; ++ch)
+            FloatVectorOperations::copy (outputs[ch] + start, buffer.getReadPointer (ch), numThisTime);
+    }
+
+    return TVFDN_OK;
+}
+
+tvfdn_result tvfdn_get_line_levels (const tvfdn_engine* engine, float* peaks, float* rms, int numLines)
+{
+    if (engine == nullptr || numLines < 0)
+        return TVFDN_ERROR_INVALID_ARGUMENT;
+
+    auto& watchdog = engine->fdn.watchdog;
+
+    for (int j = 0; j < jmin (numLines, TVFDN_NUM_CHANNELS); ++j)
+    {
+        if (peaks != nullptr)
+            peaks[j] = watchdog.linePeakLevels[(size_t) j].load (std::memory_order_relaxed);
+
+        if (rms != nullptr)
+            rms[j] = watchdog.lineRmsLevels[(size_t) j].load (std::memory_order_relaxed);
+    }
+
+    return TVFDN_OK;
+}
+
+float tvfdn_get_feedback_gain (const tvfdn_engine* engine)
+{
+    return engine != nullptr ? engine->fdn.watchdog.gainLevel.load (std::memory_order_relaxed) : 1.f;
+}
+
+const char* tvfdn_get_kernel_variant (const tvfdn_engine* engine)
+{
+    return engine != nullptr ? engine->fdn.kernelName.load (std::memory_order_relaxed) : "";
+}
+
+int tvfdn_get_processing_block_size (const tvfdn_engine* engine)
+{
+    return engine != nullptr ? engine->fdn.blockSizeLevel.load (std::memory_order_relaxed) : 0;
+}
+
+int tvfdn_get_current_order (const tvfdn_engine* engine)
+{
+    return engine != nullptr ? engine->fdn.orderLevel.load (std::memory_order_relaxed) : 0;
+}
+
+tvfdn_result tvfdn_morph_feedback_matrix (tvfdn_engine* engine, const float* matrix, double seconds)
+{
+    if (engine == nullptr || matrix == nullptr || ! engine->fdn.morphFeedbackMatrix (matrix, seconds))
+        return TVFDN_ERROR_INVALID_ARGUMENT;
+
+    return TVFDN_OK;
+}
+
+float tvfdn_get_morph_progress (const tvfdn_engine* engine)
+{
+    return engine != nullptr ? engine->fdn.morph.progress.load (std::memory_order_relaxed) : 1.f;
+}
@@ -0,0 +1,220 @@
+/*
+ ==============================================================================
+
+ Plain C interface to the TVFDN engine, for hosts that embed the network
+ without a plugin wrapper (e.g. a low-latency audio server).
+
+ Audio is exchanged as planar float buffers, one pointer per channel.
+ tvfdn_set_param may be called from any thread; tvfdn_prepare and
+ tvfdn_process must not run concurrently.
+
+ ==============================================================================
+ */
+
+#ifndef TVFDN_H
+#define TVFDN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined (TVFDN_SHARED)
+ #if defined (_WIN32)
+  #if defined (TVFDN_BUILDING)
+   #define TVFDN_API __declspec(dllexport)
+  #else
+   #define TVFDN_API __declspec(dllimport)
+  #endif
+ #else
+  #define TVFDN_API __attribute__ ((visibility ("default")))
+ #endif
+#else
+ #define TVFDN_API
+#endif
+
+/** Order of the network: maximum number of input and output channels. */
+#define TVFDN_NUM_CHANNELS 64
+
+typedef struct tvfdn_engine tvfdn_engine;
+
+typedef enum tvfdn_result
+{
+    TVFDN_OK = 0,
+    TVFDN_ERROR_INVALID_ARGUMENT = -1,
+    TVFDN_ERROR_NOT_PREPARED = -2
+} tvfdn_result;
+
+/** Same parameters, ranges and units as the plugin. Switches are 0 (off) or 1 (on). */
+typedef enum tvfdn_param
+{
+    TVFDN_PARAM_RT_DC = 0,                  /**< seconds */
+    TVFDN_PARAM_RT_NY,                      /**< seconds */
+    TVFDN_PARAM_RT_CROSSOVER_FREQUENCY,     /**< Hz */
+    TVFDN_PARAM_OSC_FREQUENCY,              /**< Hz */
+    TVFDN_PARAM_DELAY_FACTOR,
+    TVFDN_PARAM_FREQUENCY_SPREAD,
+    TVFDN_PARAM_TV_BYPASSED,
+    TVFDN_PARAM_ABSORPTION_BYPASSED,
+    TVFDN_PARAM_MULTIBAND_ABSORPTION,       /**< octave-band RT instead of RT_DC/RT_NY */
+    TVFDN_PARAM_RT_63HZ,                    /**< seconds, octave band */
+    TVFDN_PARAM_RT_125HZ,
+    TVFDN_PARAM_RT_250HZ,
+    TVFDN_PARAM_RT_500HZ,
+    TVFDN_PARAM_RT_1KHZ,
+    TVFDN_PARAM_RT_2KHZ,
+    TVFDN_PARAM_RT_4KHZ,
+    TVFDN_PARAM_RT_8KHZ,
+    TVFDN_PARAM_EARLY_REFLECTIONS,          /**< convolve with the IR set by tvfdn_set_early_reflections */
+    TVFDN_PARAM_SUBBAND_MODE,               /**< decimated network for the lows, short one for the highs */
+    TVFDN_PARAM_ADAPTIVE_ORDER,             /**< fade to 32 lines while the engine runs short of time */
+    TVFDN_NUM_PARAMS
+} tvfdn_param;
+
+/** Storage format of the delay lines. The 16-bit formats halve the memory traffic of
+    long lines at the cost of precision; the README lists their SNR against float.
+*/
+typedef enum tvfdn_delay_precision
+{
+    TVFDN_DELAY_FLOAT32 = 0,
+    TVFDN_DELAY_FLOAT16,
+    TVFDN_DELAY_BFLOAT16
+} tvfdn_delay_precision;
+
+/** Internal signals the tracer can record, combined as bit flags. */
+typedef enum tvfdn_trace_signal
+{
+    TVFDN_TRACE_DELAY_OUTPUTS = 1 << 0,
+    TVFDN_TRACE_POST_ABSORPTION = 1 << 1,
+    TVFDN_TRACE_POST_MIXING = 1 << 2,       /**< after the TV or static feedback matrix */
+    TVFDN_TRACE_OSCILLATOR_PHASES = 1 << 3,
+    TVFDN_TRACE_ALL = (1 << 4) - 1
+} tvfdn_trace_signal;
+
+/** Allocates an engine with default parameters, or returns NULL. */
+TVFDN_API tvfdn_engine* tvfdn_create (void);
+
+TVFDN_API void tvfdn_destroy (tvfdn_engine* engine);
+
+/** Must be called before processing and whenever the sample rate, the maximum block
+    size or the channel counts change. Not real-time safe.
+*/
+TVFDN_API tvfdn_result tvfdn_prepare (tvfdn_engine* engine,
+                                      double sampleRate,
+                                      int maximumBlockSize,
+                                      int numInputs,
+                                      int numOutputs);
+
+/** Loads measured early reflections, numChannels planar arrays of numSamples at
+    sampleRate: one channel per line, or fewer channels repeated over the lines. The FDN
+    tail then starts where the IR ends. numSamples = 0 removes the IR. The data is copied,
+    IRs longer than 0.5 s are cut. Not real-time safe, but may run concurrently with
+    tvfdn_process: the IR is partitioned on a background thread and replaces the current
+    one at the start of a later block, starting from silence.
+*/
+TVFDN_API tvfdn_result tvfdn_set_early_reflections (tvfdn_engine* engine,
+                                                    const float* const* ir,
+                                                    int numChannels,
+                                                    int numSamples,
+                                                    double sampleRate);
+
+/** Switches the delay-line storage format (float32 by default) and clears the lines.
+    Not real-time safe, but may run concurrently with tvfdn_process: the lines are
+    allocated by the caller and swapped in at the start of the next block.
+*/
+TVFDN_API tvfdn_result tvfdn_set_delay_precision (tvfdn_engine* engine, tvfdn_delay_precision precision);
+
+/** Arms the signal tracer: the last `seconds` of the selected tvfdn_trace_signal flags are
+    kept in memory. On tvfdn_trigger_trace, or when the stability watchdog engages, half
+    of that is recorded past the trigger and written by a background thread into a new
+    folder in directory (raw float32 files and an info.txt). Call after tvfdn_prepare.
+    Allocates, so not real-time safe, but may run concurrently with tvfdn_process, which
+    arms the new recording at the start of its next block.
+*/
+TVFDN_API tvfdn_result tvfdn_enable_trace (tvfdn_engine* engine, int signals, double seconds, const char* directory);
+
+/** Stops recording; may be called from any thread. */
+TVFDN_API void tvfdn_disable_trace (tvfdn_engine* engine);
+
+/** Requests a trace; may be called from any thread. Ignored while the last one is written. */
+TVFDN_API void tvfdn_trigger_trace (tvfdn_engine* engine);
+
+/** Number of traces written so far. */
+TVFDN_API int tvfdn_get_num_traces (const tvfdn_engine* engine);
+
+/** Sets param, clamped to its range, from the next tvfdn_process call on. May be called
+    from any thread. While param has points pending from tvfdn_schedule_param, they take
+    precedence: the value set here is held back and only applies once the last of them has
+    passed (unless a later tvfdn_schedule_param call ends on another value).
+*/
+TVFDN_API tvfdn_result tvfdn_set_param (tvfdn_engine* engine, tvfdn_param param, float value);
+
+/** Sample-accurate automation: param reaches value at sampleOffset, counted from the start
+    of the next tvfdn_process call (later calls count on from there). The reverberation
+    times, the crossover, the oscillator frequency and the spread ramp linearly to it from
+    their previous point, or from the start of the next tvfdn_process call; the other
+    parameters switch at that sample. Blocks are only split at the points, so the cost
+    grows with the number of points, not with the block length. Up to 1024 points can be
+    pending. Must be called from the thread that calls tvfdn_process, between calls.
+    See tvfdn_set_param for values set while points are pending.
+*/
+TVFDN_API tvfdn_result tvfdn_schedule_param (tvfdn_engine* engine, tvfdn_param param, float value, int sampleOffset);
+
+TVFDN_API float tvfdn_get_param (const tvfdn_engine* engine, tvfdn_param param);
+
+/** Processes numSamples frames of any length. inputs holds numInputs channel pointers,
+    outputs numOutputs, as given to tvfdn_prepare. Inputs and outputs may alias.
+*/
+TVFDN_API tvfdn_result tvfdn_process (tvfdn_engine* engine,
+                                      const float* const* inputs,
+                                      float* const* outputs,
+                                      int numSamples);
+
+/** Copies the per-line peak and RMS levels of the last processed block.
+    Either array may be NULL; numLines is clamped to TVFDN_NUM_CHANNELS.
+*/
+TVFDN_API tvfdn_result tvfdn_get_line_levels (const tvfdn_engine* engine,
+                                              float* peaks,
+                                              float* rms,
+                                              int numLines);
+
+/** Feedback gain currently applied by the stability watchdog (1 when not engaged). */
+TVFDN_API float tvfdn_get_feedback_gain (const tvfdn_engine* engine);
+
+/** Name of the kernel variant in use ("sse2", "avx2", "avx512", "neon" or "scalar").
+    tvfdn_prepare starts with the best variant for this CPU and asks a background thread
+    to time the variants; tvfdn_process switches to the fastest once that finished (a few
+    hundred milliseconds), and again after a tvfdn_prepare with a larger block size.
+    Setting the environment variable TVFDN_KERNELS to one of these names before
+    tvfdn_prepare forces that variant, if supported.
+*/
+TVFDN_API const char* tvfdn_get_kernel_variant (const tvfdn_engine* engine);
+
+/** Number of frames the engine processes at a time: the whole block until the tuning
+    described at tvfdn_get_kernel_variant has finished, then the fastest size measured,
+    at most the block size of tvfdn_prepare. */
+TVFDN_API int tvfdn_get_processing_block_size (const tvfdn_engine* engine);
+
+/** Number of lines currently heard: TVFDN_NUM_CHANNELS, or 32 while
+    TVFDN_PARAM_ADAPTIVE_ORDER has reduced the network.
+*/
+TVFDN_API int tvfdn_get_current_order (const tvfdn_engine* engine);
+
+/** Glides the feedback matrix used with TVFDN_PARAM_TV_BYPASSED to matrix
+    (TVFDN_NUM_CHANNELS x TVFDN_NUM_CHANNELS, row-major, orthogonal) over seconds,
+    through orthogonal matrices only, so the network stays lossless. The path is
+    computed on a background thread and the morph starts with a later tvfdn_process
+    call; a call during a morph continues from where that one ends. A matrix of
+    determinant -1 is reached with its last column negated. Returns
+    TVFDN_ERROR_INVALID_ARGUMENT if matrix is not orthogonal. May be called from any
+    thread but the one that calls tvfdn_process.
+*/
+TVFDN_API tvfdn_result tvfdn_morph_feedback_matrix (tvfdn_engine* engine, const float* matrix, double seconds);
+
+/** 0 to 1 during a morph, 1 otherwise. */
+TVFDN_API float tvfdn_get_morph_progress (const tvfdn_engine* engine);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ ==============================================================================
+
+ Lifecycle of the C API: argument checks, processing before and after
+ tvfdn_prepare, parameters, scheduled points and re-preparing with another
+ block size. Returns 1 on the first failed check.
+
+ usage: tvfdn_api_tests
+
+ ==============================================================================
+ */
+
+#include "tvfdn.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#define CHECK(condition) \
+    if (! (condition)) { std::fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); return 1; }
+
+static constexpr int numChannels = TVFDN_NUM_CHANNELS;
+
+struct Buffers
+{
+    std::vector<std::vector<float>> channels;
+    std::vector<float*> pointers;
+
+    Buffers (int numSamples) : channels ((size_t) numChannels, std::vector<float> ((size_t) numSamples, 0.f))
+    {
+        for (auto& channel : channels)
+            pointers.push_back (channel.data());
+    }
+
+    bool isFinite() const
+    {
+        for (auto& channel : channels)
+            for (float sample : channel)
+                if (! std::isfinite (sample))
+                    return false;
+
+        return true;
+    }
+
+    double energy() const
+    {
+        double sum = 0.0;
+        for (auto& channel : channels)
+            for (float sample : channel)
+                sum += (double) sample * sample;
+
+        return sum;
+    }
+};
+
+int main()
+{
+    // NULL engines are rejected, not dereferenced
+    CHECK (tvfdn_prepare (nullptr, 48000.0, 256, numChannels, numChannels) == TVFDN_ERROR_INVALID_ARGUMENT);
+    CHECK (tvfdn_set_param (nullptr, TVFDN_PARAM_RT_DC, 2.f) == TVFDN_ERROR_INVALID_ARGUMENT);
+    tvfdn_destroy (nullptr);
+
+    tvfdn_engine* engine = tvfdn_create();
+    CHECK (engine != nullptr);
+
+    Buffers buffers (256);
+    const float* const* inputs = buffers.pointers.data();
+    float* const* outputs = buffers.pointers.data();
+
+    CHECK (tvfdn_process (engine, inputs, outputs, 256) == TVFDN_ERROR_NOT_PREPARED);
+    CHECK (tvfdn_prepare (engine, 0.0, 256, numChannels, numChannels) == TVFDN_ERROR_INVALID_ARGUMENT);
+    CHECK (tvfdn_prepare (engine, 48000.0, 256, numChannels + 1, numChannels) == TVFDN_ERROR_INVALID_ARGUMENT);
+    CHECK (tvfdn_prepare (engine, 48000.0, 256, numChannels, numChannels) == TVFDN_OK);
+
+    // parameters are clamped to their range, invalid ones rejected
+    CHECK (tvfdn_set_param (engine, TVFDN_PARAM_RT_DC, 2.f) == TVFDN_OK);
+    CHECK (tvfdn_get_param (engine, TVFDN_PARAM_RT_DC) == 2.f);
+    CHECK (tvfdn_set_param (engine, TVFDN_PARAM_RT_DC, 1000.f) == TVFDN_OK);
+    CHECK (tvfdn_get_param (engine, TVFDN_PARAM_RT_DC) == 10.f);
+    CHECK (tvfdn_set_param (engine, TVFDN_PARAM_RT_DC, NAN) == TVFDN_ERROR_INVALID_ARGUMENT);
+    CHECK (tvfdn_set_param (engine, TVFDN_NUM_PARAMS, 1.f) == TVFDN_ERROR_INVALID_ARGUMENT);
+    CHECK (tvfdn_set_param (engine, TVFDN_PARAM_RT_DC, 2.f) == TVFDN_OK);
+
+    // an impulse into every line rings on after the block it came in
+    for (auto& channel : buffers.channels)
+        channel[0] = 1.f;
+
+    CHECK (tvfdn_process (engine, inputs, outputs, 256) == TVFDN_OK);
+    CHECK (tvfdn_process (engine, inputs, outputs, 0) == TVFDN_OK);
+
+    double tail = 0.0;
+    for (int block = 0; block < 40; ++block)
+    {
+        for (auto& channel : buffers.channels)
+            std::fill (channel.begin(), channel.end(), 0.f);
+
+        CHECK (tvfdn_process (engine, inputs, outputs, 256) == TVFDN_OK);
+        CHECK (buffers.isFinite());
+        tail += buffers.energy();
+    }
+    CHECK (tail > 0.0);
+
+    // longer blocks than prepared are split, not rejected
+    Buffers longer (1000);
+    CHECK (tvfdn_process (engine, longer.pointers.data(), longer.pointers.data(), 1000) == TVFDN_OK);
+    CHECK (longer.isFinite());
+
+    // a point holds its value once passed
+    CHECK (tvfdn_schedule_param (engine, TVFDN_PARAM_RT_NY, 3.f, 100) == TVFDN_OK);
+    CHECK (tvfdn_schedule_param (engine, TVFDN_PARAM_RT_NY, 3.f, -1) == TVFDN_ERROR_INVALID_ARGUMENT);
+    CHECK (tvfdn_process (engine, inputs, outputs, 256) == TVFDN_OK);
+    CHECK (tvfdn_get_param (engine, TVFDN_PARAM_RT_NY) == 3.f);
+
+    CHECK (tvfdn_get_feedback_gain (engine) == 1.f);
+    CHECK (tvfdn_get_kernel_variant (engine) != nullptr);
+    CHECK (tvfdn_get_processing_block_size (engine) >= 1);
+    CHECK (tvfdn_get_current_order (engine) == numChannels);
+
+    // again with a larger block and fewer channels
+    CHECK (tvfdn_prepare (engine, 44100.0, 512, 2, 2) == TVFDN_OK);
+    Buffers stereo (512);
+    stereo.channels[0][0] = 1.f;
+    CHECK (tvfdn_process (engine, stereo.pointers.data(), stereo.pointers.data(), 512) == TVFDN_OK);
+    CHECK (stereo.isFinite());
+    CHECK (tvfdn_get_processing_block_size (engine) <= 512);
+
+    tvfdn_destroy (engine);
+
+    std::printf ("C API lifecycle: passed\n");
+    return 0;
+}
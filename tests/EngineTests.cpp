@@ -0,0 +1,678 @@
+/*
+ ==============================================================================
+
+ Checks of the engine classes, one per ctest entry:
+
+ static_impulse_response  FDN::process with the static matrix against a
+                          reference recursion in double, built from the
+                          same delays, filter coefficients and matrix
+ watchdog_nan_reset       a NaN fed into a line is caught and the lines are
+                          cleared; an empty block is no reason to reset
+ morph_orthogonality      every matrix on the way of a morph is orthogonal,
+                          and the morph ends on the target
+ async_latency            AsyncFDN delays FDN::process by exactly the
+                          latency it reports, also after a stalled DSP thread
+ transpose_exactness      the host I/O transposes of every supported kernel
+                          variant, for 64, 24 and 17 channels
+ subband_reconstruction   the two bands of SubbandFDN add up to the input,
+                          `latency` samples late, and each tone stays in
+                          its band
+ early_reflection_convolution
+                          the partitioned convolution against a direct one
+ half_conversion          the software fp16 conversion against F16C, bit for
+                          bit, NaNs included
+ automation_timing        a scheduled switch changes the output exactly at
+                          its sample
+
+ Returns 1 when the check fails.
+
+ usage: tvfdn_engine_tests <check>
+
+ ==============================================================================
+ */
+
+#include "FDN.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#define CHECK(condition) \
+    if (! (condition)) { std::fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); return false; }
+
+static constexpr size_t N = 64;
+static constexpr double sampleRate = 48000.0;
+
+static void prepare (FDN& fdn, size_t blockSize)
+{
+    dsp::ProcessSpec spec { sampleRate, (uint32) blockSize, (uint32) N };
+    dsp::ProcessSpec filterSpec = spec;
+    filterSpec.numChannels = 1;
+
+    fdn.autotune = false;
+    fdn.prepare (spec, filterSpec);
+}
+
+static bool isFinite (const AudioBuffer<float>& buffer)
+{
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        for (int i = 0; i < buffer.getNumSamples(); ++i)
+            if (! std::isfinite (buffer.getSample (ch, i)))
+                return false;
+
+    return true;
+}
+
+//==============================================================================
+static bool staticImpulseResponse()
+{
+    const size_t blockSize = 256, numBlocks = 100, input = 5;
+
+    auto fdn = std::make_unique<FDN>();
+    prepare (*fdn, blockSize);
+    fdn->TVBypassed = true;
+    fdn->RT_DC = 2.f;
+    fdn->RT_NY = 0.7f;
+
+    // the reference: lines of lineDelay samples, the first-order filters after them, then
+    // output[o] = sum_r transposed[r][o] filtered[r], fed back with the input
+    AudioBuffer<float> buffer ((int) N, (int) blockSize);
+    buffer.clear();
+    dsp::AudioBlock<float> first (buffer);
+    fdn->process (first.getSubBlock (0, 0));     // applies the parameters to the filters
+
+    const auto& delays = fdn->delays.lineDelay;
+    const auto& filters = fdn->absorptionFilters;
+    const float* transposed = fdn->feedbackMatrixTransposed.getRawDataPointer();
+
+    std::vector<std::vector<double>> lines (N);
+    std::vector<size_t> positions (N, 0);
+    std::vector<double> states (N, 0.0), filtered (N), output (N);
+    for (size_t j = 0; j < N; j++)
+        lines[j].assign ((size_t) delays[j], 0.0);
+
+    double maxError = 0.0, peak = 0.0;
+
+    for (size_t b = 0; b < numBlocks; b++)
+    {
+        buffer.clear();
+        if (b == 0)
+            buffer.setSample ((int) input, 0, 1.f);
+
+        dsp::AudioBlock<float> block (buffer);
+        fdn->process (block);
+
+        for (size_t i = 0; i < blockSize; i++)
+        {
+            for (size_t j = 0; j < N; j++)
+            {
+                const double x = lines[j][positions[j]];
+                const double y = filters.b0[j] * x + states[j];
+                states[j] = filters.b1[j] * x - filters.a1[j] * y;
+                filtered[j] = y;
+            }
+
+            for (size_t o = 0; o < N; o++)
+            {
+                double sum = 0.0;
+                for (size_t r = 0; r < N; r++)
+                    sum += (double) transposed[r * N + o] * filtered[r];
+                output[o] = sum;
+            }
+
+            for (size_t j = 0; j < N; j++)
+            {
+                lines[j][positions[j]] = output[j] + (b == 0 && i == 0 && j == input ? 1.0 : 0.0);
+                positions[j] = (positions[j] + 1) % lines[j].size();
+
+                maxError = std::max (maxError, std::abs ((double) buffer.getSample ((int) j, (int) i) - output[j]));
+                peak = std::max (peak, std::abs (output[j]));
+            }
+        }
+    }
+
+    std::printf ("static IR: peak %g, largest deviation %g\n", peak, maxError);
+    CHECK (peak > 0.01);
+    CHECK (maxError < 1e-5 * peak);
+    return true;
+}
+
+//==============================================================================
+static bool watchdogNanReset()
+{
+    const size_t blockSize = 256;
+
+    auto fdn = std::make_unique<FDN>();
+    prepare (*fdn, blockSize);
+    fdn->TVBypassed = true;
+
+    AudioBuffer<float> buffer ((int) N, (int) blockSize);
+
+    for (int b = 0; b < 20; ++b)
+    {
+        buffer.clear();
+        if (b < 5)
+            for (int ch = 0; ch < (int) N; ++ch)
+                buffer.setSample (ch, 0, 0.5f);
+
+        dsp::AudioBlock<float> block (buffer);
+        fdn->process (block);
+    }
+    CHECK (fdn->watchdog.numResets.load() == 0);
+
+    AudioBuffer<float> empty ((int) N, 0);
+    dsp::AudioBlock<float> emptyBlock (empty);
+    fdn->process (emptyBlock);
+    CHECK (fdn->watchdog.numResets.load() == 0);
+
+    buffer.clear();
+    buffer.setSample (3, 10, NAN);
+    buffer.setSample (3, 11, 1.f);
+    {
+        dsp::AudioBlock<float> block (buffer);
+        fdn->process (block);
+    }
+
+    // the NaN comes out of its line after the line's delay
+    for (int b = 0; b < 40 && fdn->watchdog.numResets.load() == 0; ++b)
+    {
+        buffer.clear();
+        dsp::AudioBlock<float> block (buffer);
+        fdn->process (block);
+    }
+    CHECK (fdn->watchdog.numResets.load() == 1);
+
+    for (int b = 0; b < 40; ++b)
+    {
+        buffer.clear();
+        if (b == 0)
+            buffer.setSample (7, 0, 1.f);
+
+        dsp::AudioBlock<float> block (buffer);
+        fdn->process (block);
+        CHECK (isFinite (buffer));
+    }
+    CHECK (fdn->watchdog.numResets.load() == 1);
+
+    std::printf ("watchdog: NaN caught, %d reset\n", fdn->watchdog.numResets.load());
+    return true;
+}
+
+//==============================================================================
+// largest entry of M^T M - I, M given by its columns
+static double orthogonalityError (const std::vector<std::vector<float>>& columns)
+{
+    double error = 0.0;
+
+    for (size_t a = 0; a < columns.size(); a++)
+    {
+        for (size_t b = 0; b < columns.size(); b++)
+        {
+            double sum = 0.0;
+            for (size_t k = 0; k < columns[a].size(); k++)
+                sum += (double) columns[a][k] * columns[b][k];
+
+            error = std::max (error, std::abs (sum - (a == b ? 1.0 : 0.0)));
+        }
+    }
+
+    return error;
+}
+
+static bool morphOrthogonality()
+{
+    const size_t blockSize = 256;
+
+    auto fdn = std::make_unique<FDN>();
+    prepare (*fdn, blockSize);
+    fdn->TVBypassed = true;
+
+    // the transpose of the current matrix, far from it and orthogonal as well
+    std::vector<float> target (N * N);
+    const float* current = fdn->feedbackMatrix.getRawDataPointer();
+    for (size_t r = 0; r < N; r++)
+        for (size_t c = 0; c < N; c++)
+            target[r * N + c] = current[c * N + r];
+
+    CHECK (fdn->morphFeedbackMatrix (target.data(), 0.1));
+
+    AudioBuffer<float> buffer ((int) N, (int) blockSize);
+    std::vector<std::vector<float>> columns (N, std::vector<float> (N));
+    std::vector<float> unit (N);
+    double largestError = 0.0;
+    int morphedBlocks = 0;
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds (10);
+
+    while (morphedBlocks == 0 || fdn->morph.active)
+    {
+        CHECK (std::chrono::steady_clock::now() < deadline);
+
+        buffer.clear();
+        dsp::AudioBlock<float> block (buffer);
+        fdn->process (block);
+
+        if (fdn->morph.active)
+        {
+            // the matrix the frames of the next block are mixed with, column by column
+            for (size_t c = 0; c < N; c++)
+            {
+                std::fill (unit.begin(), unit.end(), 0.f);
+                unit[c] = 1.f;
+                fdn->morph.apply (unit.data(), columns[c].data(), *fdn->kernels);
+            }
+
+            largestError = std::max (largestError, orthogonalityError (columns));
+            morphedBlocks++;
+        }
+        else
+        {
+            std::this_thread::sleep_for (std::chrono::milliseconds (1));
+        }
+    }
+
+    double targetError = 0.0;
+    for (size_t k = 0; k < N * N; k++)
+        targetError = std::max (targetError, (double) std::abs (fdn->feedbackMatrix.getRawDataPointer()[k] - target[k]));
+
+    std::printf ("morph: %d blocks, largest orthogonality error %g, distance to the target %g\n", morphedBlocks, largestError, targetError);
+    CHECK (morphedBlocks > 1);
+    CHECK (largestError < 1e-4);
+    CHECK (targetError < 1e-5);
+    return true;
+}
+
+//==============================================================================
+static bool asyncLatency()
+{
+    // a stall of ten host blocks runs out of output, but leaves room in the input
+    const size_t hostBlockSize = 64, internalBlockSize = 256;
+    const int numBlocks = 1000, stallFrom = 300, stallBlocks = 10;
+
+    auto reference = std::make_unique<FDN>();
+    auto fdn = std::make_unique<FDN>();
+    prepare (*reference, hostBlockSize);
+    reference->TVBypassed = true;
+    fdn->autotune = false;
+
+    AsyncFDN async (*fdn);
+    dsp::ProcessSpec spec { sampleRate, (uint32) hostBlockSize, (uint32) N };
+    dsp::ProcessSpec filterSpec = spec;
+    filterSpec.numChannels = 1;
+    async.prepare (spec, filterSpec, internalBlockSize, N, N);
+
+    FDNParameters parameters;
+    parameters.TVBypassed = true;
+
+    const int latency = async.getLatencySamples();
+    std::vector<float> expected, actual;
+    AudioBuffer<float> referenceBuffer ((int) N, (int) hostBlockSize), buffer ((int) N, (int) hostBlockSize);
+
+    for (int b = 0; b < numBlocks; ++b)
+    {
+        referenceBuffer.clear();
+        if (b % 40 == 0)
+            for (int ch = 0; ch < (int) N; ++ch)
+                referenceBuffer.setSample (ch, 0, ch % 2 == 0 ? 0.5f : -0.25f);
+        buffer.makeCopyOf (referenceBuffer);
+
+        dsp::AudioBlock<float> referenceBlock (referenceBuffer), block (buffer);
+        reference->process (referenceBlock);
+
+        // a DSP thread that misses its deadline for a while
+        if (b == stallFrom)
+            async.stop();
+        if (b == stallFrom + stallBlocks)
+            async.start();
+
+        async.setParameters (parameters);
+        async.process (block);
+
+        for (int i = 0; i < (int) hostBlockSize; ++i)
+        {
+            expected.push_back (referenceBuffer.getSample (3, i));
+            actual.push_back (buffer.getSample (3, i));
+        }
+
+        std::this_thread::sleep_for (std::chrono::milliseconds (1));
+    }
+
+    // from well after the stall on, the output is the reference, delayed by the latency
+    double maxError = 0.0, peak = 0.0;
+    for (size_t n = (size_t) (stallFrom + stallBlocks + 40) * hostBlockSize; n < actual.size(); n++)
+    {
+        maxError = std::max (maxError, (double) std::abs (actual[n] - expected[n - (size_t) latency]));
+        peak = std::max (peak, (double) std::abs (expected[n - (size_t) latency]));
+    }
+
+    std::printf ("async: latency %d, %d underruns, %d overflows, largest deviation %g of %g\n", latency,
+                 async.numUnderruns.load(), async.numOverflows.load(), maxError, peak);
+    CHECK (async.numUnderruns.load() > 0);
+    CHECK (async.numOverflows.load() == 0);
+    CHECK (async.drift == 0);
+    CHECK (peak > 0.0);
+    CHECK (maxError <= 1e-6 * peak);
+    return true;
+}
+
+//==============================================================================
+static bool transposeExactness()
+{
+    const size_t channelCounts[] { 64, 24, 17 };
+    const size_t frameCounts[] { 256, 37 };     // whole tiles, and a remainder for every tile
+
+    for (auto& variant : Kernels::variants)
+    {
+        if (! variant.isSupported())
+        {
+            std::printf ("transpose: %s not supported on this CPU, skipped\n", variant.name);
+            continue;
+        }
+
+        for (size_t numChannels : channelCounts)
+        {
+            for (size_t numFrames : frameCounts)
+            {
+                std::vector<std::vector<float>> planar (numChannels, std::vector<float> (numFrames));
+                std::vector<std::vector<float>> back (numChannels, std::vector<float> (numFrames, -1.f));
+                std::vector<const float*> in;
+                std::vector<float*> out;
+
+                for (size_t c = 0; c < numChannels; c++)
+                {
+                    for (size_t f = 0; f < numFrames; f++)
+                        planar[c][f] = (float) (c * 1000 + f);
+
+                    in.push_back (planar[c].data());
+                    out.push_back (back[c].data());
+                }
+
+                std::vector<float> frames (numFrames * numChannels, -1.f);
+                variant.planarToFrames (in.data(), frames.data(), numChannels, numFrames);
+
+                for (size_t f = 0; f < numFrames; f++)
+                    for (size_t c = 0; c < numChannels; c++)
+                        CHECK (frames[f * numChannels + c] == planar[c][f]);
+
+                variant.framesToPlanar (frames.data(), out.data(), numChannels, numFrames);
+                CHECK (back == planar);
+            }
+        }
+
+        std::printf ("transpose: %s exact\n", variant.name);
+    }
+
+    return true;
+}
+
+//==============================================================================
+static double rms (const std::vector<float>& signal)
+{
+    double sum = 0.0;
+    for (float x : signal)
+        sum += (double) x * x;
+
+    return std::sqrt (sum / (double) signal.size());
+}
+
+static bool subbandReconstruction()
+{
+    auto fdn = std::make_unique<FDN>();
+    prepare (*fdn, 256);
+    auto& subband = fdn->subband;
+
+    // line j carries a tone of frequencies[j % 3]: in the low band, in the high band, and
+    // noise for the sum
+    const double frequencies[] { 1000.0, 12000.0, 0.0 };
+    const size_t numFrames = 4096, settled = 512;
+    const size_t latency = SubbandFDN::latency;
+
+    Random random (1);
+    std::vector<float> inputs (numFrames * N), frame (N), output (N), lines (N), low (N);
+    for (size_t i = 0; i < numFrames; i++)
+        for (size_t j = 0; j < N; j++)
+            inputs[i * N + j] = frequencies[j % 3] > 0.0 ? (float) std::sin (MathConstants<double>::twoPi * frequencies[j % 3] / sampleRate * (double) i)
+                                                         : random.nextFloat() * 2.f - 1.f;
+
+    std::vector<std::vector<float>> lowBands (3), highBands (3), delayed (3);
+    double sumError = 0.0;
+
+    for (size_t i = 0; i < numFrames; i++)
+    {
+        subband.processFrame (inputs.data() + i * N, output.data(), lines.data(), 1.f, true, false);
+
+        // the low band as the output stage reconstructs it from the decimated input;
+        // split holds the high band
+        subband.kernels->weightedFrameSum (subband.lowInputs.data() + subband.lowPosition * N,
+                                           subband.interpolation[subband.phase].data(), SubbandFDN::tapsPerPhase, low.data(), N);
+
+        if (i < settled)
+            continue;
+
+        for (size_t j = 0; j < N; j++)
+        {
+            const float x = inputs[(i - latency) * N + j];
+            sumError = std::max (sumError, (double) std::abs (low[j] + subband.split[j] - x));
+
+            if (j < 3)
+            {
+                lowBands[j].push_back (low[j]);
+                highBands[j].push_back (subband.split[j]);
+                delayed[j].push_back (x);
+            }
+        }
+    }
+
+    // what is left of the 1 kHz tone in the high band, and of the 12 kHz tone in the low band
+    const double lowLeak = rms (highBands[0]) / rms (delayed[0]);
+    const double highLeak = rms (lowBands[1]) / rms (delayed[1]);
+
+    std::printf ("subband: bands add up to the input %zu samples late within %g, 1 kHz in the high band %.1f dB, 12 kHz in the low band %.1f dB\n",
+                 latency, sumError, 20.0 * std::log10 (lowLeak), 20.0 * std::log10 (highLeak));
+    CHECK (sumError < 1e-5);
+    CHECK (lowLeak < 0.01);
+    CHECK (highLeak < 0.01);
+    return true;
+}
+
+//==============================================================================
+static bool earlyReflectionConvolution()
+{
+    // partition 0 direct, partition 1 on this thread, the rest as worker jobs; three IR
+    // channels repeated over the lines
+    const size_t irLength = 4800, numFrames = 6000, numIrChannels = 3;
+
+    Random random (2);
+    AudioBuffer<float> ir ((int) numIrChannels, (int) irLength);
+    for (int c = 0; c < ir.getNumChannels(); ++c)
+        for (int t = 0; t < ir.getNumSamples(); ++t)
+            ir.setSample (c, t, (random.nextFloat() * 2.f - 1.f) * std::exp (-(float) t / 1000.f));
+
+    EarlyReflectionConvolver convolver (N);
+    convolver.setImpulseResponse (ir, sampleRate);
+    convolver.prepare ({ sampleRate, 256, (uint32) N });
+    CHECK (convolver.active->numPartitions > 2);
+
+    std::vector<float> input (numFrames * N), early (numFrames * N), send (N);
+    for (auto& x : input)
+        x = random.nextFloat() * 2.f - 1.f;
+
+    // the worker's job runs right after the frame that requests it, always in time
+    for (size_t i = 0; i < numFrames; i++)
+    {
+        convolver.processFrame (input.data() + i * N, early.data() + i * N, send.data());
+        convolver.runPendingJob();
+    }
+
+    // every fifth line, which still meets all three IR channels
+    double maxError = 0.0, peak = 0.0;
+    for (size_t j = 0; j < N; j += 5)
+    {
+        const float* h = ir.getReadPointer ((int) (j % numIrChannels));
+
+        for (size_t n = 0; n < numFrames; n++)
+        {
+            double sum = 0.0;
+            for (size_t t = 0; t < irLength && t <= n; t++)
+                sum += (double) h[t] * input[(n - t) * N + j];
+
+            maxError = std::max (maxError, std::abs (sum - (double) early[n * N + j]));
+            peak = std::max (peak, std::abs (sum));
+        }
+    }
+
+    std::printf ("early reflections: %zu partitions, %d late, largest deviation %g of %g\n",
+                 convolver.active->numPartitions, convolver.numLateBlocks.load(), maxError, peak);
+    CHECK (convolver.numLateBlocks.load() == 0);
+    CHECK (maxError < 1e-5 * peak);
+    return true;
+}
+
+//==============================================================================
+static bool halfConversion()
+{
+    // each line is one sample long, so a frame written is the frame read back
+    std::vector<uint16_t> storage (N);
+    std::vector<int> position (N), begin (N), length (N, 1), delay (N, 0);
+    for (size_t j = 0; j < N; j++)
+        position[j] = begin[j] = (int) j;
+
+    auto toHalf = [&] (const Kernels::Variant& variant, const float* in, uint16_t* out)
+    {
+        variant.writeLinesHalf (storage.data(), position.data(), begin.data(), length.data(), in, N);
+        std::copy (storage.begin(), storage.end(), out);
+    };
+
+    auto toFloat = [&] (const Kernels::Variant& variant, const uint16_t* in, float* out)
+    {
+        std::copy (in, in + N, storage.begin());
+        variant.readLinesHalf (storage.data(), position.data(), delay.data(), begin.data(), length.data(), out, N);
+    };
+
+    // the baseline converts in software
+    const auto& software = Kernels::getBaseline();
+    int numCompared = 0;
+
+    for (auto& variant : Kernels::variants)
+    {
+        if (&variant == &software || ! variant.isSupported())
+            continue;
+
+        std::vector<uint16_t> bits (N), expectedBits (N);
+        std::vector<float> floats (N), actual (N), expected (N);
+        long mismatches = 0;
+
+        // every half
+        for (uint32_t h0 = 0; h0 < 0x10000; h0 += (uint32_t) N)
+        {
+            for (size_t j = 0; j < N; j++)
+                bits[j] = (uint16_t) (h0 + j);
+
+            toFloat (software, bits.data(), expected.data());
+            toFloat (variant, bits.data(), actual.data());
+            mismatches += std::memcmp (expected.data(), actual.data(), N * sizeof (float)) != 0;
+        }
+
+        // every float down to the bits that only decide whether the dropped part is zero
+        for (uint32_t top = 0; top < (1u << 24); top += (uint32_t) N)
+        {
+            for (uint32_t low : { 0u, 1u })
+            {
+                for (size_t j = 0; j < N; j++)
+                {
+                    const uint32_t u = ((top + (uint32_t) j) << 8) | low;
+                    std::memcpy (&floats[j], &u, sizeof (u));
+                }
+
+                toHalf (software, floats.data(), expectedBits.data());
+                toHalf (variant, floats.data(), bits.data());
+                mismatches += expectedBits != bits;
+            }
+        }
+
+        std::printf ("fp16: software conversion against %s, %ld frames differ\n", variant.name, mismatches);
+        CHECK (mismatches == 0);
+        numCompared++;
+    }
+
+    if (numCompared == 0)
+        std::printf ("fp16: no hardware conversion on this CPU, nothing to compare\n");
+
+    return true;
+}
+
+//==============================================================================
+static bool automationTiming()
+{
+    // the point falls inside a later host block and inside a processing chunk
+    const size_t blockSize = 256, numBlocks = 24, pointSample = 19 * blockSize + 37;
+
+    auto reference = std::make_unique<FDN>();
+    auto fdn = std::make_unique<FDN>();
+    for (FDN* engine : { reference.get(), fdn.get() })
+    {
+        prepare (*engine, blockSize);
+        engine->TVBypassed = true;
+        engine->processingBlockSize = 64;
+    }
+
+    CHECK (fdn->scheduleParameter (AutomationParameter::AbsorptionBypassed, 1.f, pointSample));
+
+    Random random (3);
+    AudioBuffer<float> referenceBuffer ((int) N, (int) blockSize), buffer ((int) N, (int) blockSize);
+    size_t firstDifference = numBlocks * blockSize;
+
+    for (size_t b = 0; b < numBlocks; b++)
+    {
+        for (int ch = 0; ch < (int) N; ++ch)
+            for (int i = 0; i < (int) blockSize; ++i)
+                referenceBuffer.setSample (ch, i, random.nextFloat() * 2.f - 1.f);
+        buffer.makeCopyOf (referenceBuffer);
+
+        dsp::AudioBlock<float> referenceBlock (referenceBuffer), block (buffer);
+        reference->process (referenceBlock);
+        fdn->process (block);
+
+        for (size_t i = 0; i < blockSize && firstDifference == numBlocks * blockSize; i++)
+            for (int ch = 0; ch < (int) N; ++ch)
+                if (buffer.getSample (ch, (int) i) != referenceBuffer.getSample (ch, (int) i))
+                    firstDifference = b * blockSize + i;
+    }
+
+    std::printf ("automation: point at sample %zu, first changed output at %zu\n", pointSample, firstDifference);
+    CHECK (firstDifference == pointSample);
+    CHECK (fdn->AbsorptionBypassed && ! fdn->hasPendingEvents (AutomationParameter::AbsorptionBypassed));
+    return true;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    const struct { const char* name; bool (*run)(); } checks[] {
+        { "static_impulse_response", staticImpulseResponse },
+        { "watchdog_nan_reset", watchdogNanReset },
+        { "morph_orthogonality", morphOrthogonality },
+        { "async_latency", asyncLatency },
+        { "transpose_exactness", transposeExactness },
+        { "subband_reconstruction", subbandReconstruction },
+        { "early_reflection_convolution", earlyReflectionConvolution },
+        { "half_conversion", halfConversion },
+        { "automation_timing", automationTiming },
+    };
+
+    for (auto& check : checks)
+        if (argc > 1 && std::strcmp (argv[1], check.name) == 0)
+            return check.run() ? 0 : 1;
+
+    std::fprintf (stderr, "usage: %s <check>, one of:", argv[0]);
+    for (auto& check : checks)
+        std::fprintf (stderr, " %s", check.name);
+    std::fprintf (stderr, "\n");
+    return 1;
+}